@@ -0,0 +1,446 @@
+#include <iostream>
+#include <fstream>
+#include <vector>
+#include <map>
+#include <string>
+#include <cmath>
+#include <algorithm>
+#include <stdexcept>
+#include <iterator>
+#include <set>
+
+#include "libckt.hpp"
+#include "librow.hpp"
+#include "libbookshelf.hpp"
+
+namespace {
+
+const std::string delimiters = " \t\r:";
+
+// open a file named in the .aux, relative to the .aux directory
+void openSibling(const std::string& aux_filename, const std::string& name,
+		 std::ifstream& file)
+{
+  std::string dir;
+  std::size_t slash = aux_filename.find_last_of("/");
+  if (slash != std::string::npos)
+    dir = aux_filename.substr(0, slash + 1);
+  file.open(dir + name);
+  if (!file.is_open())
+    throw std::runtime_error("failed to open " + dir + name);
+}
+
+// read the next line split into tokens, skipping comments and headers
+bool nextLine(std::ifstream& file, std::vector<std::string>& elements)
+{
+  std::string currentLine;
+  while (std::getline(file, currentLine)) {
+    elements.clear();
+    if (currentLine.find_first_of("#") == 0
+	|| currentLine.compare(0, 4, "UCLA") == 0)
+      continue;
+    parseLine(currentLine, elements, delimiters);
+    if (!elements.empty())
+      return true;
+  }
+  return false;
+}
+
+void parseScl(std::ifstream& file, bookshelf& design)
+{
+  std::vector<std::string> elements;
+  sclRow current = {0.0, 1.0, 1.0, 0.0, 0};
+  while (nextLine(file, elements)) {
+    const std::string& key = elements.front();
+    if (key == "CoreRow") {
+      current = {0.0, 1.0, 1.0, 0.0, 0};
+    } else if (key == "Coordinate") {
+      current.y = std::stod(elements.at(1));
+    } else if (key == "Height") {
+      current.height = std::stod(elements.at(1));
+    } else if (key == "Sitewidth") {
+      current.siteWidth = std::stod(elements.at(1));
+    } else if (key == "SubrowOrigin") {
+      // SubrowOrigin : x NumSites : n
+      current.origin = std::stod(elements.at(1));
+      if (elements.size() > 3 && elements.at(2) == "NumSites")
+	current.numSites = std::stoi(elements.at(3));
+    } else if (key == "NumSites") {
+      current.numSites = std::stoi(elements.at(1));
+    } else if (key == "End") {
+      design.scl.push_back(current);
+    }
+  }
+  if (design.scl.empty())
+    throw std::runtime_error("no CoreRow in .scl");
+  std::sort(design.scl.begin(), design.scl.end(),
+	    [](const sclRow& a, const sclRow& b) {
+	      return a.y < b.y;
+	    });
+  design.siteWidth = design.scl.front().siteWidth;
+  design.rowHeight = design.scl.front().height;
+  design.minOrigin = design.scl.front().origin;
+  for (const auto& i : design.scl) {
+    design.minOrigin = std::min(design.minOrigin, i.origin);
+    if (design.rowY.empty() || design.rowY.back() != i.y)
+      design.rowY.push_back(i.y);
+  }
+}
+
+void parseNodes(std::ifstream& file,
+		std::vector<node*>& nodes_vector,
+		cellMap& nodes,
+		bookshelf& design)
+{
+  std::vector<std::string> elements;
+  while (nextLine(file, elements)) {
+    if (elements.front() == "NumNodes" || elements.front() == "NumTerminals")
+      continue;
+    // name width height [terminal | terminal_NI]
+    node *cell = new node(elements.front(), "UNDEF");
+    double width = std::stod(elements.at(1));
+    double height = std::stod(elements.at(2));
+    nodes.insert(std::make_pair(cell->getNameId(), cell));
+    nodes_vector.push_back(cell);
+    if (elements.size() > 3 && elements[3].compare(0, 8, "terminal") == 0) {
+      cell->setDoubleWidth(0); // its footprint is cut out of the rows
+      design.fixed.push_back({cell, width, height, 0.0, 0.0, "N",
+	    elements[3] == "terminal_NI" ? "/FIXED_NI" : "/FIXED"});
+    } else {
+      cell->setDoubleWidth(std::lround(2.0 * width / design.siteWidth));
+      design.movable.push_back(cell);
+      design.size[cell] = std::make_pair(width, height);
+    }
+  }
+}
+
+// the placer keeps one net per driver and only sums the nets of cells
+// in rows, so the O pin drives the net if it is movable, otherwise
+// the first movable pin does. the bounding box does not depend on the
+// driver, but a cell driving two nets gets one merged box, and pins
+// sit at the corner of their cell. the nets are also kept as written,
+// with their pin offsets, for bookshelfHPWL()
+void parseNets(std::ifstream& file, cellMap& nodes,
+	       bookshelf& design)
+{
+  std::set<node*> fixed;
+  for (const auto& i : design.fixed)
+    fixed.insert(i.cell);
+  std::vector<std::string> elements;
+  std::vector<node*> pins;
+  node *driver = nullptr;
+  auto flush = [&]() {
+    if (!driver) {
+      for (auto i : pins) {
+	if (!fixed.count(i)) {
+	  driver = i;
+	  break;
+	}
+      }
+    }
+    if (driver) { // a net of fixed cells only has a constant length
+      for (auto i : pins) {
+	if (i == driver)
+	  continue;
+	driver->pushFanout(i);
+	i->pushFanin(driver);
+      }
+    }
+    pins.clear();
+    driver = nullptr;
+  };
+  while (nextLine(file, elements)) {
+    if (elements.front() == "NumNets" || elements.front() == "NumPins")
+      continue;
+    if (elements.front() == "NetDegree") {
+      flush();
+      pins.reserve(std::stoi(elements.at(1)));
+      design.nets.push_back(std::vector<bookshelfPin>());
+      continue;
+    }
+    node *pin = findCell(nodes, elements.front());
+    if (!pin)
+      throw std::runtime_error("unknown node " + elements.front()
+			       + " in .nets");
+    if (design.nets.empty())
+      throw std::runtime_error("pin " + elements.front()
+			       + " before NetDegree in .nets");
+    // name direction : dx dy
+    double dx = 0.0, dy = 0.0;
+    if (elements.size() > 3) {
+      dx = std::stod(elements[2]);
+      dy = std::stod(elements[3]);
+    }
+    design.nets.back().push_back({pin, dx, dy});
+    if (elements.size() > 1 && elements[1] == "O" && !driver
+	&& !fixed.count(pin))
+      driver = pin;
+    else
+      pins.push_back(pin);
+  }
+  flush();
+}
+
+void parsePl(std::ifstream& file, cellMap& nodes,
+	     bookshelf& design)
+{
+  std::map<node*, fixedCell*> fixed;
+  for (auto& i : design.fixed)
+    fixed[i.cell] = &i;
+  std::vector<std::string> elements;
+  while (nextLine(file, elements)) {
+    node *cell = findCell(nodes, elements.front());
+    if (!cell || elements.size() < 3)
+      continue;
+    double x = std::stod(elements[1]), y = std::stod(elements[2]);
+    auto f = fixed.find(cell);
+    if (f != fixed.end()) {
+      f->second->x = x;
+      f->second->y = y;
+      if (elements.size() > 3 && elements[3] != "/FIXED"
+	  && elements[3] != "/FIXED_NI")
+	f->second->orient = elements[3];
+    } else {
+      design.initial[cell] = std::make_pair(x, y);
+    }
+  }
+}
+
+// row index for a y coordinate, rows are sorted by y
+std::size_t nearestRow(const bookshelf& design, double y)
+{
+  auto iter = std::lower_bound(design.rowY.begin(), design.rowY.end(), y);
+  if (iter == design.rowY.end())
+    return design.rowY.size() - 1;
+  if (iter != design.rowY.begin() && y - *std::prev(iter) < *iter - y)
+    --iter;
+  return iter - design.rowY.begin();
+}
+
+// lower-left corner and size of a cell in .pl units
+void footprint(const bookshelf& design,
+	       const std::map<node*, const fixedCell*>& fixed, node *cell,
+	       double& x, double& y, double& width, double& height)
+{
+  auto f = fixed.find(cell);
+  if (f != fixed.end()) {
+    const fixedCell& i = *f->second;
+    bool turned = i.orient == "E" || i.orient == "W"
+      || i.orient == "FE" || i.orient == "FW";
+    x = i.x;
+    y = i.y;
+    width = turned ? i.height : i.width;
+    height = turned ? i.width : i.height;
+    return;
+  }
+  x = design.minOrigin + cell->getDoubleX() * design.siteWidth / 2.0;
+  y = design.rowY[cell->getY() - 1];
+  const auto& size = design.size.at(cell);
+  width = size.first;
+  height = size.second;
+}
+
+// a gap widened to whole sites of a row starting at dorigin
+std::pair<int, int> siteAligned(double dfirst, double dsecond, int dorigin)
+{
+  int first = dorigin + 2 * int(std::floor((dfirst - dorigin) / 2.0));
+  int second = dorigin + 2 * int(std::ceil((dsecond - dorigin) / 2.0));
+  return std::make_pair(first, second);
+}
+
+// the rows of the .scl merged by y. the holes between the subrows of
+// a row and the footprints of terminals over it become its gaps,
+// terminal_NI cells let cells sit under them
+void buildRows(const bookshelf& design, std::vector<row*>& rows)
+{
+  int dmaxWidth = 0;
+  for (auto i : design.movable)
+    dmaxWidth = std::max(dmaxWidth, i->getDoubleWidth());
+  std::map<node*, const fixedCell*> fixed;
+  for (const auto& i : design.fixed)
+    fixed[i.cell] = &i;
+  auto unit = [&](double x) {
+    return 2.0 * (x - design.minOrigin) / design.siteWidth;
+  };
+  auto sub = design.scl.begin();
+  for (auto y : design.rowY) {
+    std::vector<std::pair<int, int> > spans;
+    for (; sub != design.scl.end() && sub->y == y; ++sub) {
+      int dorigin = std::lround(unit(sub->origin));
+      spans.push_back(std::make_pair(dorigin, dorigin + int(std::lround(
+	      2.0 * sub->numSites * sub->siteWidth / design.siteWidth))));
+    }
+    std::sort(spans.begin(), spans.end());
+    int dorigin = spans.front().first, dend = dorigin;
+    std::vector<std::pair<int, int> > blocked;
+    for (const auto& i : spans) {
+      if (i.first > dend)
+	blocked.push_back(std::make_pair(dend, i.first));
+      dend = std::max(dend, i.second);
+    }
+    for (const auto& i : fixed) {
+      if (i.second->mark == "/FIXED_NI")
+	continue;
+      double x0, y0, width, height;
+      footprint(design, fixed, i.first, x0, y0, width, height);
+      if (width <= 0 || height <= 0 || y0 >= y + design.rowHeight
+	  || y0 + height <= y)
+	continue;
+      blocked.push_back(siteAligned(unit(x0), unit(x0 + width), dorigin));
+    }
+    std::sort(blocked.begin(), blocked.end());
+    row *r = new row(dend - dorigin, dorigin);
+    r->setGaps(blocked, dmaxWidth);
+    rows.push_back(r);
+  }
+}
+
+} // namespace
+
+bool isBookshelf(const std::string& filename)
+{
+  return filename.size() > 4
+    && filename.compare(filename.size() - 4, 4, ".aux") == 0;
+}
+
+// read the files listed in the .aux line by line into the netlist
+int parseBookshelf(const std::string& aux_filename,
+		   std::vector<node*>& nodes_vector,
+		   cellMap& nodes,
+		   bookshelf& design)
+{
+  std::ifstream aux(aux_filename);
+  if (!aux.is_open())
+    throw std::runtime_error("failed to open " + aux_filename);
+  std::vector<std::string> elements;
+  std::string currentLine;
+  while (std::getline(aux, currentLine) && elements.empty())
+    parseLine(currentLine, elements, delimiters);
+  std::map<std::string, std::string> files;
+  for (const auto& i : elements) {
+    std::size_t dot = i.find_last_of(".");
+    if (dot != std::string::npos)
+      files[i.substr(dot + 1)] = i;
+  }
+  const char *required[] = {"scl", "nodes", "nets"};
+  for (auto i : required)
+    if (!files.count(i))
+      throw std::runtime_error(std::string("no .") + i + " in "
+			       + aux_filename);
+  std::ifstream file;
+  openSibling(aux_filename, files["scl"], file);
+  parseScl(file, design);
+  file.close();
+  openSibling(aux_filename, files["nodes"], file);
+  parseNodes(file, nodes_vector, nodes, design);
+  file.close();
+  openSibling(aux_filename, files["nets"], file);
+  parseNets(file, nodes, design);
+  file.close();
+  if (files.count("pl")) {
+    openSibling(aux_filename, files["pl"], file);
+    parsePl(file, nodes, design);
+    file.close();
+  }
+  // rows are about rowHeight / siteWidth sites high
+  node::dRowHeight = std::max(1L, std::lround(2.0 * design.rowHeight
+					       / design.siteWidth));
+  // terminals sit at their .pl position in placer units
+  for (auto& i : design.fixed) {
+    i.cell->setDoubleX(std::lround(2.0 * (i.x - design.minOrigin)
+				   / design.siteWidth));
+    i.cell->setY(std::lround((i.y - design.scl.front().y)
+			     / design.rowHeight) + 1);
+  }
+  return 0;
+}
+
+// build the rows of the .scl and fill them in .pl order, a cell that
+// does not fit its nearest row goes to the closest row with room
+bool bookshelfPlacement(bookshelf& design, std::vector<row*>& rows)
+{
+  rows.clear();
+  buildRows(design, rows);
+  std::vector<node*> order(design.movable);
+  std::map<node*, std::size_t> home;
+  for (auto i : order) {
+    auto search = design.initial.find(i);
+    home[i] = (search == design.initial.end()) ? 0
+      : nearestRow(design, search->second.second);
+  }
+  std::stable_sort(order.begin(), order.end(), [&](node *a, node *b) {
+      auto pa = design.initial.find(a), pb = design.initial.find(b);
+      double xa = (pa == design.initial.end()) ? 0.0 : pa->second.first;
+      double xb = (pb == design.initial.end()) ? 0.0 : pb->second.first;
+      return xa < xb;
+    });
+  int height = rows.size();
+  for (auto i : order) {
+    int r = home[i];
+    bool placed = false;
+    for (int d = 0; d < height && !placed; ++d) {
+      if (r + d < height)
+	placed = rows[r + d]->push_back(i);
+      if (!placed && d && r - d >= 0)
+	placed = rows[r - d]->push_back(i);
+    }
+    if (!placed)
+      return false;
+  }
+  std::cout << "Bookshelf Placement Generated" << std::endl
+	    << "Rows:" << height << std::endl
+	    << "Movable cells:" << design.movable.size() << std::endl
+	    << "Fixed cells:" << design.fixed.size() << std::endl;
+  return true;
+}
+
+// HPWL of the nets of the .nets, pins at the center of their cell
+// plus their offset, as Bookshelf tools measure it
+double bookshelfHPWL(const bookshelf& design)
+{
+  std::map<node*, const fixedCell*> fixed;
+  for (const auto& i : design.fixed)
+    fixed[i.cell] = &i;
+  double sum = 0.0;
+  for (const auto& net : design.nets) {
+    if (net.empty())
+      continue;
+    double xmin = 0.0, xmax = 0.0, ymin = 0.0, ymax = 0.0;
+    for (std::size_t i = 0; i < net.size(); ++i) {
+      double x, y, width, height;
+      footprint(design, fixed, net[i].cell, x, y, width, height);
+      x += width / 2.0 + net[i].dx;
+      y += height / 2.0 + net[i].dy;
+      xmin = i ? std::min(xmin, x) : x;
+      xmax = i ? std::max(xmax, x) : x;
+      ymin = i ? std::min(ymin, y) : y;
+      ymax = i ? std::max(ymax, y) : y;
+    }
+    sum += (xmax - xmin) + (ymax - ymin);
+  }
+  return sum;
+}
+
+// write every cell in .pl format, movable cells at their row position
+void writeBookshelfPl(std::ofstream& outFile, const bookshelf& design,
+		      const std::vector<node*>& nodes)
+{
+  std::map<node*, const fixedCell*> fixed;
+  for (const auto& i : design.fixed)
+    fixed[i.cell] = &i;
+  outFile.precision(15); // large coordinates stay integers
+  outFile << "UCLA pl 1.0" << std::endl << std::endl;
+  for (auto i : nodes) {
+    auto f = fixed.find(i);
+    if (f != fixed.end()) {
+      outFile << i->getName() << "\t" << f->second->x << "\t"
+	      << f->second->y << "\t: " << f->second->orient
+	      << " " << f->second->mark << std::endl;
+    } else {
+      double x, y, width, height;
+      footprint(design, fixed, i, x, y, width, height);
+      outFile << i->getName() << "\t" << x << "\t" << y << "\t: N"
+	      << std::endl;
+    }
+  }
+}
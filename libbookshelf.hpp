@@ -0,0 +1,69 @@
+#ifndef LIBBOOKSHELF_HPP
+#define LIBBOOKSHELF_HPP
+
+#include <iostream>
+#include <string>
+#include <vector>
+#include <map>
+#include <fstream>
+
+#include "libckt.hpp"
+#include "librow.hpp"
+
+// one CoreRow of the .scl file
+struct sclRow {
+  double y;
+  double height;
+  double siteWidth;
+  double origin;
+  int numSites;
+};
+
+// a terminal keeps the position given by the .pl file
+struct fixedCell {
+  node *cell;
+  double width;
+  double height;
+  double x;
+  double y;
+  std::string orient;
+  std::string mark;
+};
+
+// a pin of a .nets net, offset from the center of its cell
+struct bookshelfPin {
+  node *cell;
+  double dx;
+  double dy;
+};
+
+// what the placer needs beside the netlist to place a bookshelf design
+struct bookshelf {
+  std::vector<sclRow> scl;
+  // y of each placer row, subrows at the same y make one row
+  std::vector<double> rowY;
+  // cells that go into rows
+  std::vector<node*> movable;
+  std::vector<fixedCell> fixed;
+  // initial position of movable cells from the .pl, if any
+  std::map<node*, std::pair<double, double> > initial;
+  // width and height of movable cells from the .nodes
+  std::map<node*, std::pair<double, double> > size;
+  // the nets as written in the .nets, for bookshelfHPWL()
+  std::vector<std::vector<bookshelfPin> > nets;
+  double siteWidth = 1.0;
+  double minOrigin = 0.0;
+  double rowHeight = 1.0;
+};
+
+bool isBookshelf(const std::string& filename);
+int parseBookshelf(const std::string& aux_filename,
+		   std::vector<node*>& nodes_vector,
+		   cellMap& nodes,
+		   bookshelf& design);
+bool bookshelfPlacement(bookshelf& design, std::vector<row*>& rows);
+double bookshelfHPWL(const bookshelf& design);
+void writeBookshelfPl(std::ofstream& outFile, const bookshelf& design,
+		      const std::vector<node*>& nodes);
+
+#endif
@@ -4,8 +4,10 @@
 #include <map>
 #include <exception>
 #include <string>
+#include <new>
 
 #include "libckt.hpp"
+#include "libreport.hpp"
 
 
 // out-of-class initializations
@@ -13,6 +15,131 @@ int node::count[TypeMAX+1] = {};
 
 int node::doublearea = 0;
 
+namePool node::names;
+
+int node::dRowHeight = 2;
+
+// FNV-1a, the slot of name or the empty slot it would go to
+std::size_t namePool::slot(const std::string& name) const
+{
+  std::uint32_t hash = 2166136261u;
+  for (unsigned char c : name)
+    hash = (hash ^ c) * 16777619u;
+  std::size_t mask = table.size() - 1;
+  for (std::size_t i = hash & mask; ; i = (i + 1) & mask) {
+    std::uint32_t id = table[i];
+    if (!id)
+      return i;
+    --id;
+    if (start[id+1] - start[id] == name.size()
+	&& std::equal(name.begin(), name.end(), chars.begin() + start[id]))
+      return i;
+  }
+}
+
+// id of name, added if it is new
+std::uint32_t namePool::intern(const std::string& name)
+{
+  // keep the table at most half full
+  if (2 * (size() + 1) > table.size()) {
+    std::vector<std::uint32_t> old(std::max<std::size_t>(16,
+							  2 * table.size()));
+    old.swap(table);
+    for (auto id : old)
+      if (id)
+	table[slot(str(id - 1))] = id;
+  }
+  std::size_t i = slot(name);
+  if (!table[i]) {
+    chars.insert(chars.end(), name.begin(), name.end());
+    start.push_back(chars.size());
+    table[i] = size();
+  }
+  return table[i] - 1;
+}
+
+// give the memory back, the ids start over
+void namePool::clear()
+{
+  std::vector<char>().swap(chars);
+  std::vector<std::uint32_t>(1, 0).swap(start);
+  std::vector<std::uint32_t>().swap(table);
+}
+
+// id of name, NO_NAME if it was never added
+std::uint32_t namePool::find(const std::string& name) const
+{
+  if (table.empty())
+    return NO_NAME;
+  std::uint32_t id = table[slot(name)];
+  return id ? id - 1 : NO_NAME;
+}
+
+nameHolder::nameHolder()
+{
+  node::names.hold();
+}
+
+nameHolder::nameHolder(const nameHolder&)
+{
+  node::names.hold();
+}
+
+nameHolder::~nameHolder()
+{
+  node::names.release();
+}
+
+namespace {
+
+// allocations of copyBlock() and the cells still alive in them
+struct nodeBlock {
+  char *begin, *end;
+  std::size_t live;
+};
+std::vector<nodeBlock> blocks;
+
+} // namespace
+
+std::vector<node*> node::copyBlock(const std::vector<node*>& cells)
+{
+  std::vector<node*> ans(cells.size());
+  if (cells.empty())
+    return ans;
+  std::size_t bytes = cells.size() * sizeof(node);
+  char *mem = static_cast<char*>(::operator new(bytes));
+  for (std::size_t i = 0; i < cells.size(); ++i)
+    ans[i] = ::new (mem + i * sizeof(node)) node(*cells[i]);
+  blocks.push_back({mem, mem + bytes, cells.size()});
+  return ans;
+}
+
+void *node::operator new(std::size_t size)
+{
+  return ::operator new(size);
+}
+
+void node::operator delete(void *cell)
+{
+  char *p = static_cast<char*>(cell);
+  for (auto i = blocks.begin(); i != blocks.end(); ++i) {
+    if (p >= i->begin && p < i->end) {
+      if (!--i->live) {
+	::operator delete(i->begin);
+	blocks.erase(i);
+      }
+      return;
+    }
+  }
+  ::operator delete(cell);
+}
+
+node *findCell(const cellMap& cells, const std::string& name)
+{
+  auto search = cells.find(node::names.find(name));
+  return (search == cells.end()) ? nullptr : search->second;
+}
+
 bool node::fPosition() {
   if (dX == -1 || Y == -1)
     return false;
@@ -38,54 +165,55 @@ double node::netHPWLCal() {
     maxY = std::max(maxY, i->getY());
   }
   return double(maxDoubleX-minDoubleX) / 2.0
-    + double(maxY-minY);
+    + double(maxY-minY) * dRowHeight / 2.0;
 }
 
-std::string node::printAllFanout() const
+// "TYPE-name: TYPE-fanout, ...", appended to target
+void node::printAllFanout(std::string& target) const
 {
-  std::string target;
-  if (type == INP)
-    target = "";
-  else {
-    target = getTypeString(type);
-    target += "-" + getName() + ": ";
-    if (outputs.empty())
-      target += "OUTP\n";
-    else { // iterate through the vector
-      for (auto i = outputs.begin(); i < outputs.end(); ) {
-	target += getTypeString((*i)->type) + "-" + (*i)->getName();
-	if ((++i) != outputs.end())
-	  target += ", ";
-      }
-      target += "\n";
+  if (getType() == INP)
+    return;
+  target += getTypeName(getType());
+  target += '-';
+  appendName(target);
+  target += ": ";
+  if (outputs.empty())
+    target += "OUTP\n";
+  else { // iterate through the vector
+    for (auto i = outputs.begin(); i < outputs.end(); ) {
+      target += getTypeName((*i)->getType());
+      target += '-';
+      (*i)->appendName(target);
+      if ((++i) != outputs.end())
+	target += ", ";
     }
+    target += '\n';
   }
-  return target;
 }
 
-std::string node::printAllFanin() const
+void node::printAllFanin(std::string& target) const
 {
-  std::string target;
-  if (type == INP)
-    target = "";
-  else {
-    target = getTypeString(type);
-    target += "-" + getName() + ": ";
-    for (auto i = inputs.begin(); i < inputs.end(); ) {
-      target += getTypeString((*i)->type) + "-" + (*i)->getName();
-      if ((++i) != inputs.end())
-	target += ", ";
-    }
-    target += "\n";
+  if (getType() == INP)
+    return;
+  target += getTypeName(getType());
+  target += '-';
+  appendName(target);
+  target += ": ";
+  for (auto i = inputs.begin(); i < inputs.end(); ) {
+    target += getTypeName((*i)->getType());
+    target += '-';
+    (*i)->appendName(target);
+    if ((++i) != inputs.end())
+      target += ", ";
   }
-  return target;
+  target += '\n';
 }
 
 int parseCkt(std::ifstream& file,
 	     std::vector<node*>& inputs,
 	     std::vector<node*>& outputs,
 	     std::vector<node*>& nodes_vector,
-	     std::map<std::string, node*>& nodes)
+	     cellMap& nodes)
 {
   std::string currentLine;
   node *ptrNodeCell = nullptr;
@@ -106,8 +234,7 @@ int parseCkt(std::ifstream& file,
 	// input declaration line
 	// front() indicate input, [1] is the node name
 	ptrNodeCell = new node(elements.at(1), elements.front());
-	nodes.insert(std::make_pair(elements.at(1),
-				    ptrNodeCell));
+	nodes.insert(std::make_pair(ptrNodeCell->getNameId(), ptrNodeCell));
 	inputs.push_back(ptrNodeCell);
 	nodes_vector.push_back(ptrNodeCell);
 	ptrNodeCell->setWidth();
@@ -115,18 +242,16 @@ int parseCkt(std::ifstream& file,
 	// create a new output gate and link to the inner one
 	std::string port_name = elements.at(1) + "-OUTPUT";
 	ptrNodeCell = new node(port_name, elements.front());
-	nodes.insert(std::make_pair(port_name, ptrNodeCell));
+	nodes.insert(std::make_pair(ptrNodeCell->getNameId(), ptrNodeCell));
 	outputs.push_back(ptrNodeCell);
 	nodes_vector.push_back(ptrNodeCell);
 	ptrNodeCell->setWidth();
 	node *temp = ptrNodeCell;
 	// search for or create the actual cell
-	auto search = nodes.find(elements.at(1));
-	if (search != nodes.end()) {
-	  ptrNodeCell = search->second;
-	} else {
+	ptrNodeCell = findCell(nodes, elements.at(1));
+	if (!ptrNodeCell) {
 	  ptrNodeCell = new node(elements.at(1), "UNDEF");
-	  nodes.insert(std::make_pair(elements.at(1),
+	  nodes.insert(std::make_pair(ptrNodeCell->getNameId(),
 				      ptrNodeCell));
 	  nodes_vector.push_back(ptrNodeCell);
 	}
@@ -137,26 +262,22 @@ int parseCkt(std::ifstream& file,
 	// front() element is the name, [2] is the node name
 	// check if it is already in map, set the type and add nodes
 	// otherwise create a new node and add to map
-	auto search = nodes.find(elements.front());
-	if (search != nodes.end()) {
-	  ptrNodeCell = search->second;
+	ptrNodeCell = findCell(nodes, elements.front());
+	if (ptrNodeCell) {
 	  ptrNodeCell->setType(elements.at(2));
 	} else {
 	  ptrNodeCell = new node(elements.front(), elements.at(2));
-	  nodes.insert(std::make_pair(elements.front(),
+	  nodes.insert(std::make_pair(ptrNodeCell->getNameId(),
 				      ptrNodeCell));
 	  nodes_vector.push_back(ptrNodeCell);
 	}
 	// add edges to the adjacent vector, elements starting at [3]
 	for (auto Iter = std::next(elements.begin(), 3);
 	     Iter < elements.end(); ++Iter) {
-	  search = nodes.find(*Iter);
-	  node *adjPtr = nullptr;	  
-	  if (search != nodes.end()) {
-	    adjPtr = nodes[*Iter];
-	  } else {
+	  node *adjPtr = findCell(nodes, *Iter);
+	  if (!adjPtr) {
 	    adjPtr = new node(*Iter, "UNDEF");
-	    nodes.insert(std::make_pair(*Iter, adjPtr));
+	    nodes.insert(std::make_pair(adjPtr->getNameId(), adjPtr));
 	    nodes_vector.push_back(adjPtr);
 	  }
 	  ptrNodeCell->pushFanin(adjPtr);
@@ -209,6 +330,21 @@ void printUsage()
 {
   std::cout << "USAGE:\t./placement read_ckt <FILENAME>\t\tRead circuit and write statistics to file" << std::endl;
   std::cout << "\t./placement place <FILENAME>\t\tRead and start a random placement then do annealing" << std::endl;
+  std::cout << "\t\t\t\t\t\tA .aux file is read as a Bookshelf design and also written to annealing_result.pl" << std::endl;
+  std::cout << "\t\t[--time-budget <SECONDS>]\tFit the annealing schedule into a time budget" << std::endl;
+  std::cout << "\t\t[--move-budget <N>]\t\tFit the annealing schedule into N moves" << std::endl;
+  std::cout << "\t\t[--reorder]\t\t\tRenumber cells in reverse Cuthill-McKee order before placing (.bench only)" << std::endl;
+  std::cout << "\t\t[--cost <MODEL>]\t\tAnnealing objective: hpwl (default), timing, quadratic or congestion" << std::endl;
+  std::cout << "\t\t[--move <MODEL>]\t\tMove partners: global (default) or local, within a window that shrinks as fewer moves are accepted" << std::endl;
+  std::cout << "\t\t[--timing]\t\t\tSame as --cost timing, nets weighted by timing criticality" << std::endl;
+  std::cout << "\t\t[--congestion <WEIGHT>]\t\tSame as --cost congestion, adding WEIGHT times the RUDY penalty" << std::endl;
+  std::cout << "\t\t\t\t\t\tTiming and congestion combine, quadratic takes neither" << std::endl;
+  std::cout << "\t\t[--starts <N>]\t\t\tAnneal N chains in parallel, replacing the worst by clones of the best at checkpoints" << std::endl;
+  std::cout << "\t\t[--detail <K>]\t\t\tStop annealing early and run detailed placement with K-cell windows" << std::endl;
+  std::cout << "\t./placement generate <FILENAME> <CELLS>\tWrite a synthetic circuit" << std::endl;
+  std::cout << "\t\t[--rent <P>] [--fanout <MEAN>] [--depth <LEVELS>] [--seed <N>]" << std::endl;
+  std::cout << "\t./placement serve [--socket <PATH>]\t\tKeep circuits loaded and answer commands from stdin or a socket" << std::endl;
+  std::cout << "\t./placement bench <FILENAME>\t\tReport parse time, memory and moves/s" << std::endl;
 }
 
 GateType parseType(const std::string& name)
@@ -240,6 +376,11 @@ GateType parseType(const std::string& name)
 }
 
 std::string getTypeString(GateType Type)
+{
+  return getTypeName(Type);
+}
+
+const char *getTypeName(GateType Type)
 {
   switch (Type) {
   case NAND:
@@ -293,35 +434,42 @@ int assignDoubleWidth(GateType Type, int size)
   }
 }
 
+// the sections are formatted in parallel chunks, see writeSection()
 void printCktStatistics(const std::vector<node*>& nodes,
 			 std::ofstream& outFile)
 {
-  outFile << node::getTypeCount(INP) << " primary inputs" << std::endl;
-  outFile << node::getTypeCount(OUTP) << " primary outputs" << std::endl;
+  outFile << node::getTypeCount(INP) << " primary inputs\n";
+  outFile << node::getTypeCount(OUTP) << " primary outputs\n";
   for (GateType i = NAND; i < INP; i = GateType(1 + int(i))) {
     if (node::getTypeCount(i))
       outFile << node::getTypeCount(i) << " " << getTypeString(i)
-	      << " gates" << std::endl;
-  }
-  outFile << "Total Area: " << node::doublearea/2.0 << std::endl;
-  outFile << std::endl << std::endl << "Fanout..." << std::endl;
-  for (const auto& node: nodes) {
-    std::string result = node->printAllFanout();
-    outFile << result;
-  }
-  outFile << std::endl << std::endl << "Fanin..." << std::endl;
-  for (const auto& node: nodes) {
-    std::string result = node->printAllFanin();
-    outFile << result;
+	      << " gates\n";
   }
-  outFile << std::endl << std::endl << "Size..." << std::endl;
-  for (const auto& node: nodes) {
-    outFile << getTypeString(node->getType())
-	    << "-" << node->getName()
-	    << ": " << node->getWidth()
-	    << std::endl;
-  }
-  outFile << std::endl;
+  outFile << "Total Area: " << node::doublearea/2.0 << "\n";
+  outFile << "\n\nFanout...\n";
+  writeSection(outFile, nodes.size(),
+	       [&nodes](std::string& out, std::size_t begin, std::size_t end) {
+		 for (std::size_t i = begin; i < end; ++i)
+		   nodes[i]->printAllFanout(out);
+	       });
+  outFile << "\n\nFanin...\n";
+  writeSection(outFile, nodes.size(),
+	       [&nodes](std::string& out, std::size_t begin, std::size_t end) {
+		 for (std::size_t i = begin; i < end; ++i)
+		   nodes[i]->printAllFanin(out);
+	       });
+  outFile << "\n\nSize...\n";
+  writeSection(outFile, nodes.size(),
+	       [&nodes](std::string& out, std::size_t begin, std::size_t end) {
+		 for (std::size_t i = begin; i < end; ++i) {
+		   out += getTypeName(nodes[i]->getType());
+		   out += '-';
+		   nodes[i]->appendName(out);
+		   out += ": ";
+		   appendHalf(out, nodes[i]->getDoubleWidth());
+		   out += '\n';
+		 }
+	       });
+  outFile << "\n";
+  outFile.flush();
 }
-
-
@@ -5,8 +5,10 @@
 #include <string>
 #include <vector>
 #include <map>
+#include <unordered_map>
 #include <fstream>
 #include <algorithm>
+#include <cstdint>
 
 enum GateType {NAND, NOR, AND, OR, XOR, XNOR, INV, BUF, INP, OUTP, UNDEF,
 	       TypeMAX = UNDEF};
@@ -14,49 +16,124 @@ enum GateType {NAND, NOR, AND, OR, XOR, XNOR, INV, BUF, INP, OUTP, UNDEF,
 // library function declaration
 int assignDoubleWidth(GateType Type, int size);
 std::string getTypeString(GateType Type);
+const char *getTypeName(GateType Type);
 GateType parseType(const std::string& name);
 void printUsage();
 int parseLine(const std::string& line, std::vector<std::string>& elements,
 	      const std::string& delimiters);
 void printParsedLine(const std::vector<std::string>& elements);
 
+// id of a name not in the pool
+#define NO_NAME UINT32_MAX
 
-class node {
+// every cell name once, back to back in one buffer. cells keep a 32-bit
+// id and the text is only built again for the reports
+class namePool {
 private:
+  // name i is chars[start[i]...start[i+1]-1]
+  std::vector<char> chars;
+  std::vector<std::uint32_t> start = std::vector<std::uint32_t>(1, 0);
+  // open addressing on the names, id+1 or 0 for an empty slot
+  std::vector<std::uint32_t> table;
+  // nodes alive with a name from the pool
+  std::size_t holders = 0;
+  std::size_t slot(const std::string& name) const;
+  void clear();
+public:
+  // the pool is emptied when the last holder lets go, so a server that
+  // drops its circuits gets the names back
+  void hold() {
+    ++holders;
+  }
+  void release() {
+    if (!--holders)
+      clear();
+  }
+  std::uint32_t intern(const std::string& name);
+  std::uint32_t find(const std::string& name) const;
+  std::string str(std::uint32_t id) const {
+    return std::string(chars.data() + start[id], start[id+1] - start[id]);
+  }
+  void append(std::uint32_t id, std::string& out) const {
+    out.append(chars.data() + start[id], start[id+1] - start[id]);
+  }
+  std::size_t size() const {
+    return start.size() - 1;
+  }
+  std::size_t bytes() const {
+    return chars.capacity() + start.capacity() * sizeof(std::uint32_t)
+      + table.capacity() * sizeof(std::uint32_t);
+  }
+};
+
+class node;
+// cells of a netlist by name id
+typedef std::unordered_map<std::uint32_t, node*> cellMap;
+
+// holds node::names for as long as the node lives, copies too. an
+// empty base, the node stays the same size
+class nameHolder {
+protected:
+  nameHolder();
+  nameHolder(const nameHolder&);
+  nameHolder& operator=(const nameHolder&) = default;
+  ~nameHolder();
+};
+
+class node : private nameHolder {
+private:
+  // coordinates, width and type share 16 bytes so a move touches one
+  // small record, the whole node fits in a cache line
+  // double of x index
+  int dX = -1;
+  // y index
+  int Y = -1;
+  // height always 1, store width with doublewidth to reduce flop
+  int doublewidth : 24;
   // type indicates cell type (nand nor etc)
-  GateType type = UNDEF;
-  // outname denotes the output wire name
-  std::string outname;
+  unsigned type : 8;
+  // id of the output wire name in names
+  std::uint32_t outname;
   // fanin of the node
   std::vector<node*> inputs;
   // fanout of the node
   std::vector<node*> outputs;
-  // height always 1, store width with doublewidth to reduce flop
-  int doublewidth;
-  // double of x index
-  int dX = -1;
-  // y index
-  int Y = -1;
 public:
   // gate count
   static int count[TypeMAX + 1];
   // total area
   static int doublearea;
+  // names of all cells
+  static namePool names;
+  // height of a row in half sites, what a step in Y adds to the HPWL.
+  // a row of a .bench layout is as high as a site is wide
+  static int dRowHeight;
   // constructor
-  node(const std::string& name, const std::string& gatetype): outname(name) {
+  node(const std::string& name, const std::string& gatetype)
+    : doublewidth(0), outname(names.intern(name)) {
     type = parseType(gatetype);
     ++count[type];
   }
+  node(const std::string& name, GateType gatetype)
+    : doublewidth(0), type(gatetype), outname(names.intern(name)) {
+    ++count[type];
+  }
   void setType(const std::string& gatetype) {
     type = parseType(gatetype);
     ++count[type];
   }
   GateType getType() const {
-    return type;
+    return GateType(type);
   }
   std::string getName() const {
+    return names.str(outname);
+  }
+  std::uint32_t getNameId() const {
     return outname;
   }
+  void appendName(std::string& out) const {
+    names.append(outname, out);
+  }
   int getDoubleWidth() const {
     return doublewidth;
   }
@@ -77,7 +154,17 @@ public:
   }
   void setWidth() {
     int size = inputs.size();
-    doublewidth = assignDoubleWidth(type, size);
+    doublewidth = assignDoubleWidth(getType(), size);
+    doublearea += doublewidth;
+  }
+  // fanin count changed, recompute the width
+  void updateWidth() {
+    doublearea -= doublewidth;
+    setWidth();
+  }
+  // width given by the input file instead of the gate type
+  void setDoubleWidth(int dwidth) {
+    doublewidth = dwidth;
     doublearea += doublewidth;
   }
   void pushFanin(node *newnode) {
@@ -86,20 +173,55 @@ public:
   void pushFanout(node *newnode) {
     outputs.push_back(newnode);
   }
+  void removeFanin(node *oldnode) {
+    auto iter = std::find(inputs.begin(), inputs.end(), oldnode);
+    if (iter != inputs.end())
+      inputs.erase(iter);
+  }
+  void removeFanout(node *oldnode) {
+    auto iter = std::find(outputs.begin(), outputs.end(), oldnode);
+    if (iter != outputs.end())
+      outputs.erase(iter);
+  }
+  // point every edge to to(cell), used when cells are relocated
+  template <typename F>
+  void remapEdges(F to) {
+    for (auto& i : inputs)
+      i = to(i);
+    for (auto& i : outputs)
+      i = to(i);
+  }
+  template <typename Compare>
+  void sortFanout(Compare comp) {
+    std::sort(outputs.begin(), outputs.end(), comp);
+  }
+  const std::vector<node*>& getFanin() const {
+    return inputs;
+  }
+  const std::vector<node*>& getFanout() const {
+    return outputs;
+  }
   static int getTypeCount(GateType type) {
     return count[type];
   }
-  std::string printAllFanin() const;
-  std::string printAllFanout() const;
+  void printAllFanin(std::string& target) const;
+  void printAllFanout(std::string& target) const;
   double netHPWLCal();
   bool fPosition();
+  // copies of cells back to back in one allocation, in that order.
+  // delete still takes them one at a time, the allocation goes with
+  // the last of them
+  static std::vector<node*> copyBlock(const std::vector<node*>& cells);
+  static void *operator new(std::size_t size);
+  static void operator delete(void *cell);
 };
 
 
+node *findCell(const cellMap& cells, const std::string& name);
 int parseCkt(std::ifstream& file, std::vector<node*>& inputs,
 	     std::vector<node*>& outputs,
 	     std::vector<node*>& nodes_vector,
-	     std::map<std::string, node*>& nodes);
+	     cellMap& nodes);
 void printCktStatistics(const std::vector<node*>& nodes,
 			std::ofstream& outFile);
 
@@ -0,0 +1,291 @@
+#include <iostream>
+#include <vector>
+#include <unordered_map>
+#include <algorithm>
+#include <climits>
+#include <cmath>
+#include <cstdint>
+
+#include "libckt.hpp"
+#include "librow.hpp"
+#include "libcongestion.hpp"
+
+// the grid covers the rows, cells past them count in the border bins
+rudyMap::rudyMap(const std::vector<row*>& rows)
+{
+  xmin = INT_MAX;
+  int xmax = INT_MIN;
+  for (auto r : rows) {
+    xmin = std::min(xmin, r->getOrigin());
+    xmax = std::max(xmax, std::max(r->getEnd(),
+				   r->getOrigin() + r->getSum()));
+    for (auto driver : r->getCells()) {
+      if (driver->getFanout().empty())
+	continue;
+      index[driver] = drivers.size();
+      drivers.push_back(driver);
+    }
+  }
+  // a moved cell changes its own net and the nets of its fanin, list
+  // them per cell so update() does one lookup per cell
+  std::unordered_map<node*, int> net;
+  net.swap(index);
+  netStart.push_back(0);
+  for (auto r : rows) {
+    for (auto cell : r->getCells()) {
+      index[cell] = netStart.size() - 1;
+      auto search = net.find(cell);
+      if (search != net.end())
+	cellNets.push_back(search->second);
+      for (auto j : cell->getFanin()) {
+	search = net.find(j);
+	if (search != net.end())
+	  cellNets.push_back(search->second);
+      }
+      netStart.push_back(cellNets.size());
+    }
+  }
+  if (rows.empty())
+    xmin = xmax = 0;
+  ymin = 1;
+  dWidth = std::max(1, xmax - xmin);
+  height = std::max<int>(1, rows.size());
+  binW = std::max(2 * RUDY_MIN_BIN, (dWidth + RUDY_GRID - 1) / RUDY_GRID);
+  binH = std::max(RUDY_MIN_BIN, (height + RUDY_GRID - 1) / RUDY_GRID);
+  nx = (dWidth + binW - 1) / binW;
+  ny = (height + binH - 1) / binH;
+  boxes.resize(drivers.size());
+  stamp.assign(drivers.size(), 0);
+  work.resize(drivers.size());
+  stale.resize(drivers.size());
+  demand.assign(std::size_t(nx) * ny, 0);
+  change.assign(std::size_t(nx) * ny, 0);
+  edgeX.resize(nx + 1);
+  for (int i = 0; i <= nx; ++i)
+    edgeX[i] = xmin + i * binW;
+  edgeX[0] = INT_MIN;
+  edgeX[nx] = INT_MAX;
+  edgeY.resize(ny + 1);
+  for (int i = 0; i <= ny; ++i)
+    edgeY[i] = ymin + i * binH;
+  edgeY[0] = INT_MIN;
+  edgeY[ny] = INT_MAX;
+  oldX.resize(nx);
+  newX.resize(nx);
+  oldY.resize(ny);
+  newY.resize(ny);
+}
+
+rudyMap::box rudyMap::calBox(int net) const
+{
+  node *driver = drivers[net];
+  box ans = {driver->getDoubleX(), driver->getDoubleX(),
+	     driver->getY(), driver->getY()};
+  for (auto i : driver->getFanout()) {
+    ans.x0 = std::min(ans.x0, i->getDoubleX());
+    ans.x1 = std::max(ans.x1, i->getDoubleX());
+    ans.y0 = std::min(ans.y0, i->getY());
+    ans.y1 = std::max(ans.y1, i->getY());
+  }
+  return ans;
+}
+
+// wire a grown box puts on each unit of its area (a site by a row),
+// 0 for a flat net
+static double density(int x0, int x1, int y0, int y1)
+{
+  int hpwl = (x1 - x0) + node::dRowHeight * (y1 - y0); // doubled
+  return double(hpwl) / (2.0 * (x1 - x0 + 2) * (y1 - y0 + 1));
+}
+
+// fixed point share of a box in one bin from the share of a unit of
+// its width in that row of bins. always computed the same way, so
+// taking a box off cancels adding it exactly
+static inline std::int64_t share(double row, int ovx)
+{
+  return std::int64_t(row * ovx + 0.5);
+}
+
+// overlap of [lo, hi) with each bin from first to last on one axis
+static void overlap(int lo, int hi, const int *edges,
+		    int first, int last, int *ov)
+{
+  for (int i = first; i <= last; ++i)
+    ov[i] = std::max(0, std::min(edges[i+1], hi) - std::max(edges[i], lo));
+}
+
+// bins under a grown box
+void rudyMap::cover(const box& b, int& bx0, int& bx1,
+		    int& by0, int& by1) const
+{
+  bx0 = std::min(nx - 1, std::max(0, (b.x0 - xmin) / binW));
+  bx1 = std::min(nx - 1, std::max(0, (b.x1 + 1 - xmin) / binW));
+  by0 = std::min(ny - 1, std::max(0, (b.y0 - ymin) / binH));
+  by1 = std::min(ny - 1, std::max(0, (b.y1 - ymin) / binH));
+}
+
+// overlaps of a grown box with the bins of a range, 0 past the box
+void rudyMap::overlaps(const box& b, int bx0, int bx1, int by0, int by1,
+		       int *ovx, int *ovy) const
+{
+  overlap(b.x0, b.x1 + 2, edgeX.data(), bx0, bx1, ovx);
+  overlap(b.y0, b.y1 + 1, edgeY.data(), by0, by1, ovy);
+}
+
+// move the demand of a net from its stored box to b in one pass over
+// the bins under either box, into the change of the bins
+void rudyMap::moveNet(int net, const box& b)
+{
+  const box& a = boxes[net];
+  int ax0, ax1, ay0, ay1, bx0, bx1, by0, by1;
+  cover(a, ax0, ax1, ay0, ay1);
+  cover(b, bx0, bx1, by0, by1);
+  double da = density(a.x0, a.x1, a.y0, a.y1);
+  double db = density(b.x0, b.x1, b.y0, b.y1);
+  int x0 = std::min(ax0, bx0), x1 = std::max(ax1, bx1);
+  int y0 = std::min(ay0, by0), y1 = std::max(ay1, by1);
+  cx0 = std::min(cx0, x0);
+  cx1 = std::max(cx1, x1);
+  cy0 = std::min(cy0, y0);
+  cy1 = std::max(cy1, y1);
+  if (x0 == x1 && y0 == y1) {
+    // both boxes in one bin, which overlaps all of them
+    change[std::size_t(y0) * nx + x0]
+      += share(RUDY_SCALE * db * (b.y1 - b.y0 + 1), b.x1 - b.x0 + 2)
+      - share(RUDY_SCALE * da * (a.y1 - a.y0 + 1), a.x1 - a.x0 + 2);
+  } else {
+    overlaps(a, x0, x1, y0, y1, oldX.data(), oldY.data());
+    overlaps(b, x0, x1, y0, y1, newX.data(), newY.data());
+    for (int y = y0; y <= y1; ++y) {
+      std::int64_t *c = change.data() + std::size_t(y) * nx;
+      double ra = RUDY_SCALE * da * oldY[y], rb = RUDY_SCALE * db * newY[y];
+      for (int x = x0; x <= x1; ++x)
+	c[x] += share(rb, newX[x]) - share(ra, oldX[x]);
+    }
+  }
+  boxLog.push_back({net, a});
+  boxes[net] = b;
+}
+
+// map of the current coordinates
+void rudyMap::build()
+{
+  std::fill(demand.begin(), demand.end(), 0);
+  sumSquares = 0;
+  for (std::size_t i = 0; i < drivers.size(); ++i) {
+    box b = calBox(i);
+    int x0, x1, y0, y1;
+    cover(b, x0, x1, y0, y1);
+    overlaps(b, x0, x1, y0, y1, newX.data(), newY.data());
+    double db = density(b.x0, b.x1, b.y0, b.y1);
+    for (int y = y0; y <= y1; ++y) {
+      double rb = RUDY_SCALE * db * newY[y];
+      for (int x = x0; x <= x1; ++x)
+	demand[std::size_t(y) * nx + x] += share(rb, newX[x]);
+    }
+    boxes[i] = b;
+  }
+  for (auto d : demand)
+    sumSquares += d * d;
+}
+
+// move the demand of the nets of moved cells whose box changed. a pin
+// that stays inside a box or moves past its edge changes the box
+// without looking at the other pins, only a pin leaving an edge inward
+// needs the whole net. swap() records every cell once per move
+void rudyMap::update(const journal& jn)
+{
+  binLog.clear();
+  boxLog.clear();
+  touched.clear();
+  if (!++epoch) { // wrapped around, forget the old stamps
+    std::fill(stamp.begin(), stamp.end(), 0);
+    epoch = 1;
+  }
+  for (std::size_t i = 0; i < jn.coordCount(); ++i) {
+    node *moved = jn.coordCell(i);
+    auto search = index.find(moved);
+    if (search == index.end())
+      continue;
+    int cell = search->second;
+    int fromX = jn.coordDoubleX(i), fromY = jn.coordY(i);
+    int toX = moved->getDoubleX(), toY = moved->getY();
+    for (std::size_t k = netStart[cell]; k < netStart[cell+1]; ++k) {
+      int net = cellNets[k];
+      if (stamp[net] != epoch) {
+	stamp[net] = epoch;
+	work[net] = boxes[net];
+	stale[net] = false;
+	touched.push_back(net);
+      }
+      if (stale[net])
+	continue;
+      box& b = work[net];
+      if ((fromX == b.x0 && toX > b.x0) || (fromX == b.x1 && toX < b.x1)
+	  || (fromY == b.y0 && toY > b.y0) || (fromY == b.y1 && toY < b.y1)) {
+	stale[net] = true;
+	continue;
+      }
+      b.x0 = std::min(b.x0, toX);
+      b.x1 = std::max(b.x1, toX);
+      b.y0 = std::min(b.y0, toY);
+      b.y1 = std::max(b.y1, toY);
+    }
+  }
+  cx0 = cy0 = INT_MAX;
+  cx1 = cy1 = INT_MIN;
+  for (auto net : touched) {
+    box b = stale[net] ? calBox(net) : work[net];
+    if (!(b == boxes[net]))
+      moveNet(net, b);
+  }
+  for (int y = cy0; y <= cy1; ++y) {
+    for (int x = cx0; x <= cx1; ++x) {
+      std::size_t bin = std::size_t(y) * nx + x;
+      std::int64_t delta = change[bin];
+      if (!delta)
+	continue;
+      change[bin] = 0;
+      sumSquares += delta * (2 * demand[bin] + delta);
+      demand[bin] += delta;
+      binLog.push_back({bin, delta});
+    }
+  }
+}
+// take back the last update() after the move is undone
+void rudyMap::revert()
+{
+  for (auto i = binLog.rbegin(); i != binLog.rend(); ++i) {
+    std::int64_t& d = demand[i->first];
+    sumSquares += i->second * (i->second - 2 * d);
+    d -= i->second;
+  }
+  for (auto i = boxLog.rbegin(); i != boxLog.rend(); ++i)
+    boxes[i->first] = i->second;
+  binLog.clear();
+  boxLog.clear();
+}
+
+// sum over the bins of demand squared over area, hot spots cost more
+// than the same wire spread out
+double rudyMap::penalty() const
+{
+  double area = binW / 2.0 * binH;
+  return sumSquares / (double(RUDY_SCALE) * RUDY_SCALE * area);
+}
+
+// demand per unit area of every bin, one line per row of bins from the
+// top of the layout. the last bins only count the part in the rows
+void rudyMap::write(std::ostream& outFile) const
+{
+  for (int by = ny - 1; by >= 0; --by) {
+    int h = std::min(binH, height - by * binH);
+    for (int bx = 0; bx < nx; ++bx) {
+      double area = std::min(binW, dWidth - bx * binW) / 2.0 * h;
+      if (bx)
+	outFile << ",";
+      outFile << demand[std::size_t(by) * nx + bx] / (RUDY_SCALE * area);
+    }
+    outFile << std::endl;
+  }
+}
@@ -0,0 +1,80 @@
+#ifndef LIBCONGESTION_HPP
+#define LIBCONGESTION_HPP
+
+#include <iostream>
+#include <vector>
+#include <unordered_map>
+#include <cstdint>
+#include <utility>
+
+#include "libckt.hpp"
+#include "librow.hpp"
+
+// bins per side at most
+#define RUDY_GRID 32
+// smallest bin side in sites and rows
+#define RUDY_MIN_BIN 16
+// demand is fixed point with this unit, so removing a net takes off
+// exactly what adding it put in
+#define RUDY_SCALE 16
+// weight of the penalty when the congestion cost is chosen without one
+#define RUDY_WEIGHT 0.05
+
+// RUDY routing demand on a grid of bins. a net spreads its HPWL
+// evenly over its bounding box, grown by one site and one row so a
+// flat net still has an area. moves follow the boxes from the old and
+// new coordinates in the journal and only touch the bins under the
+// boxes that changed
+class rudyMap {
+private:
+  struct box {
+    int x0, x1, y0, y1; // doubled x and rows of the pins
+    bool operator==(const box& b) const {
+      return x0 == b.x0 && x1 == b.x1 && y0 == b.y0 && y1 == b.y1;
+    }
+  };
+  // one net per driver in the rows, as in hpwlEngine
+  std::vector<node*> drivers;
+  // nets of the cells in the rows, cellNets[netStart[i]...]
+  std::unordered_map<node*, int> index;
+  std::vector<std::size_t> netStart;
+  std::vector<int> cellNets;
+  std::vector<box> boxes;
+  // grid in doubled x and rows, edges[0] and edges[n] of each axis
+  // are the infinite borders
+  int xmin, ymin, binW, binH, nx, ny;
+  int dWidth, height;
+  std::vector<int> edgeX, edgeY;
+  std::vector<std::int64_t> demand;
+  std::int64_t sumSquares = 0;
+  // change of each bin by the nets of the current update(), summed
+  // before it goes into the demand, and the bins it covers
+  std::vector<std::int64_t> change;
+  int cx0, cx1, cy0, cy1;
+  // what the last update() changed, for revert()
+  std::vector<std::pair<std::size_t, std::int64_t> > binLog;
+  std::vector<std::pair<int, box> > boxLog;
+  // nets of the current update() with their boxes so far, stale when
+  // a pin left an edge of the box and the box has to be computed again
+  std::vector<unsigned> stamp;
+  unsigned epoch = 0;
+  std::vector<int> touched;
+  std::vector<box> work;
+  std::vector<char> stale;
+  // overlaps of the old and new box with the bins of each axis
+  std::vector<int> oldX, oldY, newX, newY;
+  box calBox(int net) const;
+  void cover(const box& b, int& bx0, int& bx1, int& by0, int& by1) const;
+  void overlaps(const box& b, int bx0, int bx1, int by0, int by1,
+		int *ovx, int *ovy) const;
+  void moveNet(int net, const box& b);
+public:
+  rudyMap(const std::vector<row*>& rows);
+  void build();
+  void update(const journal& jn);
+  void revert();
+  double penalty() const;
+  void write(std::ostream& outFile) const;
+};
+
+#endif
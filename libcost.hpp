@@ -0,0 +1,286 @@
+#ifndef LIBCOST_HPP
+#define LIBCOST_HPP
+
+#include <vector>
+#include <random>
+#include <cmath>
+#include <algorithm>
+#include <unordered_set>
+
+#include "libckt.hpp"
+#include "librow.hpp"
+#include "util.hpp"
+#include "libhpwl.hpp"
+#include "libtiming.hpp"
+#include "libcongestion.hpp"
+
+// a local move reaches at least this many slots
+#define MOVE_RADIUS 3
+// acceptance rate the window of local moves is kept at
+#define MOVE_TARGET 0.44
+
+extern thread_local std::mt19937 gen;
+
+// cost policies of annealing() and kboltz(), which are instantiated
+// once per policy so the inner loop calls them directly
+//   start()     cost of the current placement
+//   evaluate()  cost after the move recorded in the journal
+//   accept()    the move stays, before the journal is cleared
+//   reject()    the move was rolled back
+//   step()      after every temperature, cost again since the
+//               objective may have changed
+//   hpwl()      HPWL of the current placement for the reports
+// the engines follow the journal between start() and hpwl(), which
+// copy all coordinates again
+// stable is false when costs of different temperatures do not compare,
+// then the best state is not kept
+
+// plain HPWL
+class hpwlCost {
+private:
+  hpwlEngine engine;
+public:
+  static const bool stable = true;
+  hpwlCost(std::vector<row*>& rows, const schedule& sch)
+    : engine(rows, sch.threads) {}
+  double start() {
+    engine.gather();
+    return engine.compute();
+  }
+  double evaluate(const journal& jn) {
+    engine.update(jn);
+    return engine.compute();
+  }
+  void accept(const journal&) {}
+  void reject() {
+    engine.revert();
+  }
+  double step(double current) {
+    return current;
+  }
+  double hpwl() {
+    engine.gather();
+    return engine.compute();
+  }
+};
+
+// HPWL with nets weighted by the timing criticality of their driver,
+// the weights follow the timing once per temperature
+class weightedCost {
+private:
+  hpwlEngine engine;
+  timer& timing;
+  // cells moved since the last timing update
+  std::unordered_set<node*> moved;
+  void reweight() {
+    double critical = timing.criticalDelay();
+    for (auto i : timing.getCells())
+      engine.setWeight(i, 1.0 + TIMING_WEIGHT
+		       * std::pow(timing.criticality(i, critical), CRIT_EXP));
+  }
+public:
+  static const bool stable = false;
+  weightedCost(std::vector<row*>& rows, const schedule& sch)
+    : engine(rows, sch.threads), timing(*sch.timing) {
+    timing.analyse();
+    reweight();
+  }
+  double start() {
+    double ans;
+    engine.gather();
+    engine.compute(&ans);
+    return ans;
+  }
+  double evaluate(const journal& jn) {
+    double ans;
+    engine.update(jn);
+    engine.compute(&ans);
+    return ans;
+  }
+  void accept(const journal& jn) {
+    for (std::size_t i = 0; i < jn.coordCount(); ++i)
+      moved.insert(jn.coordCell(i));
+  }
+  void reject() {
+    engine.revert();
+  }
+  // the cones of the moved cells are propagated once per temperature
+  double step(double) {
+    timing.update(std::vector<node*>(moved.begin(), moved.end()));
+    moved.clear();
+    reweight();
+    if (enableVerbose)
+      std::cout << "Critical delay:" << timing.criticalDelay() << std::endl;
+    return start();
+  }
+  double hpwl() {
+    engine.gather();
+    return engine.compute();
+  }
+};
+
+// sum of squared net width and height, pulls long nets in harder
+class quadraticCost {
+private:
+  hpwlEngine engine;
+public:
+  static const bool stable = true;
+  quadraticCost(std::vector<row*>& rows, const schedule& sch)
+    : engine(rows, sch.threads) {}
+  double start() {
+    engine.gather();
+    return engine.compute<quadraticMetric>();
+  }
+  double evaluate(const journal& jn) {
+    engine.update(jn);
+    return engine.compute<quadraticMetric>();
+  }
+  void accept(const journal&) {}
+  void reject() {
+    engine.revert();
+  }
+  double step(double current) {
+    return current;
+  }
+  double hpwl() {
+    engine.gather();
+    return engine.compute();
+  }
+};
+
+// HPWL plus the weighted RUDY congestion penalty
+class densityCost {
+private:
+  hpwlEngine engine;
+  rudyMap& congestion;
+  double weight;
+public:
+  static const bool stable = true;
+  densityCost(std::vector<row*>& rows, const schedule& sch)
+    : engine(rows, sch.threads), congestion(*sch.congestion),
+      weight(sch.congestionWeight) {
+    congestion.build();
+  }
+  double start() {
+    engine.gather();
+    return engine.compute() + weight * congestion.penalty();
+  }
+  double evaluate(const journal& jn) {
+    congestion.update(jn);
+    engine.update(jn);
+    return engine.compute() + weight * congestion.penalty();
+  }
+  void accept(const journal&) {}
+  void reject() {
+    engine.revert();
+    congestion.revert();
+  }
+  double step(double current) {
+    return current;
+  }
+  double hpwl() {
+    engine.gather();
+    return engine.compute();
+  }
+};
+
+// weighted HPWL plus the RUDY penalty, timing and congestion together
+class weightedDensityCost {
+private:
+  weightedCost weighted;
+  rudyMap& congestion;
+  double weight;
+public:
+  static const bool stable = false;
+  weightedDensityCost(std::vector<row*>& rows, const schedule& sch)
+    : weighted(rows, sch), congestion(*sch.congestion),
+      weight(sch.congestionWeight) {
+    congestion.build();
+  }
+  double start() {
+    return weighted.start() + weight * congestion.penalty();
+  }
+  double evaluate(const journal& jn) {
+    congestion.update(jn);
+    return weighted.evaluate(jn) + weight * congestion.penalty();
+  }
+  void accept(const journal& jn) {
+    weighted.accept(jn);
+  }
+  void reject() {
+    weighted.reject();
+    congestion.revert();
+  }
+  double step(double current) {
+    return weighted.step(current) + weight * congestion.penalty();
+  }
+  double hpwl() {
+    return weighted.hpwl();
+  }
+};
+
+// move policies pick the two cells a move swaps, step() gets the
+// acceptance rate after every temperature
+
+// any two cells of the layout
+class globalMove {
+public:
+  globalMove(const std::vector<row*>&) {}
+  void pick(std::vector<row*>& rows, int& row_idx1, int& itm_idx1,
+	    int& row_idx2, int& itm_idx2) {
+    std::size_t size = 0;
+    while (!size) { // in case generated an empty row
+      row_idx1 = gen() % rows.size();
+      size = rows[row_idx1]->size();
+    }
+    size = 0;
+    while (!size) { // in case generated an empty row
+      row_idx2 = gen() % rows.size();
+      size = rows[row_idx2]->size();
+    }
+    itm_idx1 = gen() % rows[row_idx1]->size();
+    itm_idx2 = gen() % rows[row_idx2]->size();
+  }
+  void step(double) {}
+};
+
+// the second cell within a window around the first, as a fraction of
+// the rows and of the row length. the window starts as the whole
+// layout and shrinks to keep the acceptance rate near MOVE_TARGET
+class localMove {
+private:
+  double range = 1.0;
+public:
+  localMove(const std::vector<row*>&) {}
+  void pick(std::vector<row*>& rows, int& row_idx1, int& itm_idx1,
+	    int& row_idx2, int& itm_idx2) {
+    std::size_t size = 0;
+    while (!size) { // in case generated an empty row
+      row_idx1 = gen() % rows.size();
+      size = rows[row_idx1]->size();
+    }
+    itm_idx1 = gen() % size;
+    int last = rows.size() - 1;
+    int dr = std::max(1, int(range * rows.size()));
+    // rows around may be empty, the row of the first cell is not
+    row_idx2 = row_idx1;
+    for (int tries = 0; tries < 2 * MOVE_RADIUS; ++tries) {
+      int r = std::min(last, std::max(0, row_idx1
+		+ int(gen() % (2 * dr + 1)) - dr));
+      if (rows[r]->size()) {
+	row_idx2 = r;
+	break;
+      }
+    }
+    std::size_t size2 = rows[row_idx2]->size();
+    int ds = std::max(MOVE_RADIUS, int(range * size2));
+    int slot = int(itm_idx1 * size2 / size)
+      + int(gen() % (2 * ds + 1)) - ds;
+    itm_idx2 = std::min(int(size2) - 1, std::max(0, slot));
+  }
+  void step(double rate) {
+    range = std::min(1.0, std::max(0.0, range * (1.0 - MOVE_TARGET + rate)));
+  }
+};
+
+#endif
@@ -0,0 +1,425 @@
+#include <vector>
+#include <algorithm>
+#include <thread>
+#include <limits>
+#include <unordered_map>
+#include <chrono>
+
+#include "libckt.hpp"
+#include "librow.hpp"
+#include "libdetail.hpp"
+#include "util.hpp"
+
+// gains smaller than this are treated as no improvement
+#define DETAIL_EPS 1e-9
+
+namespace {
+
+// a cell assumed to be at another position while evaluating
+struct location {
+  node *cell;
+  int dX;
+  int Y;
+};
+
+void position(node *cell, const location *moved, int n, int& dX, int& Y)
+{
+  for (int i = 0; i < n; ++i) {
+    if (moved[i].cell == cell) {
+      dX = moved[i].dX;
+      Y = moved[i].Y;
+      return;
+    }
+  }
+  dX = cell->getDoubleX();
+  Y = cell->getY();
+}
+
+// same as node::netHPWLCal() but the cells in moved are read from there
+double netCost(node *driver, const location *moved, int n)
+{
+  int dX, Y;
+  position(driver, moved, n, dX, Y);
+  int minDoubleX = dX, maxDoubleX = dX, minY = Y, maxY = Y;
+  for (auto i : driver->getFanout()) {
+    position(i, moved, n, dX, Y);
+    minDoubleX = std::min(minDoubleX, dX);
+    maxDoubleX = std::max(maxDoubleX, dX);
+    minY = std::min(minY, Y);
+    maxY = std::max(maxY, Y);
+  }
+  return double(maxDoubleX-minDoubleX) / 2.0
+    + double(maxY-minY) * node::dRowHeight / 2.0;
+}
+
+// every net a cell is on is named after its driver
+void collectNets(node *cell, std::vector<node*>& nets)
+{
+  nets.push_back(cell);
+  for (auto i : cell->getFanin())
+    nets.push_back(i);
+}
+
+void uniqueNets(std::vector<node*>& nets)
+{
+  std::sort(nets.begin(), nets.end());
+  nets.erase(std::unique(nets.begin(), nets.end()), nets.end());
+}
+
+double netsCost(const std::vector<node*>& nets, const location *moved, int n)
+{
+  double sum = 0.0;
+  for (auto i : nets)
+    sum += netCost(i, moved, n);
+  return sum;
+}
+
+struct proposal {
+  std::size_t row_idx;
+  std::size_t start;
+  int perm[MAX_WINDOW];
+  double gain;
+};
+
+// best order of the window starting at start, without touching the layout.
+// cells skip the gaps of the row, an order that would end past the
+// current one is left out
+void bestOrder(const std::vector<row*>& rows, proposal& p, int window)
+{
+  const row *r = rows[p.row_idx];
+  const std::vector<node*>& cells = r->getCells();
+  std::vector<node*> nets;
+  for (int i = 0; i < window; ++i)
+    collectNets(cells[p.start + i], nets);
+  uniqueNets(nets);
+  int x0 = cells[p.start]->getDoubleX();
+  int Y = cells[p.start]->getY();
+  node *back = cells[p.start + window - 1];
+  int end = back->getDoubleX() + back->getDoubleWidth();
+  double base = netsCost(nets, nullptr, 0);
+  double best = base;
+  int perm[MAX_WINDOW];
+  location moved[MAX_WINDOW];
+  for (int i = 0; i < window; ++i)
+    perm[i] = p.perm[i] = i;
+  while (std::next_permutation(perm, perm + window)) {
+    int x = x0;
+    for (int i = 0; i < window; ++i) {
+      node *cell = cells[p.start + perm[i]];
+      x = r->place(x, cell->getDoubleWidth());
+      moved[i] = {cell, x, Y};
+      x += cell->getDoubleWidth();
+    }
+    if (x > end)
+      continue;
+    double cost = netsCost(nets, moved, window);
+    if (cost < best - DETAIL_EPS) {
+      best = cost;
+      std::copy(perm, perm + window, p.perm);
+    }
+  }
+  p.gain = base - best;
+}
+
+// write back the order found by bestOrder()
+void applyOrder(std::vector<row*>& rows, const proposal& p, int window)
+{
+  row *r = rows[p.row_idx];
+  std::vector<node*> old(r->getCells().begin() + p.start,
+			 r->getCells().begin() + p.start + window);
+  int x = old.front()->getDoubleX();
+  for (int i = 0; i < window; ++i) {
+    node *cell = old[p.perm[i]];
+    r->setElement(p.start + i, cell);
+    x = r->place(x, cell->getDoubleWidth());
+    cell->setDoubleX(x);
+    x += cell->getDoubleWidth();
+  }
+}
+
+// cells that share no net can be placed independently
+bool independent(node *a, node *b)
+{
+  std::vector<node*> na, nb;
+  collectNets(a, na);
+  collectNets(b, nb);
+  for (auto i : na)
+    if (std::find(nb.begin(), nb.end(), i) != nb.end())
+      return false;
+  return true;
+}
+
+} // namespace
+
+// sliding-window exact reordering of adjacent cells
+// windows of one phase do not overlap, they are evaluated in parallel
+// against a frozen layout and applied in a fixed order afterwards, so
+// the result does not depend on the number of threads, unless the time
+// budget (seconds, 0 means unlimited) runs out and the windows left are
+// not evaluated
+double windowReorder(std::vector<row*>& rows, int window, unsigned threads,
+		     double timeBudget)
+{
+  typedef std::chrono::steady_clock Time;
+  auto deadline = Time::now() + std::chrono::duration_cast<Time::duration>
+    (std::chrono::duration<double>(timeBudget));
+  auto expired = [timeBudget, deadline]() {
+    return timeBudget > 0 && Time::now() > deadline;
+  };
+  window = std::max(2, std::min(window, MAX_WINDOW));
+  threads = std::max(1u, threads);
+  double total_gain = 0.0;
+  for (int phase = 0; phase < window && !expired(); ++phase) {
+    std::vector<proposal> list;
+    for (std::size_t r = 0; r < rows.size(); ++r) {
+      for (std::size_t s = phase; s + window <= rows[r]->size();
+	   s += window) {
+	proposal p;
+	p.row_idx = r;
+	p.start = s;
+	p.gain = 0.0;
+	list.push_back(p);
+      }
+    }
+    if (list.empty())
+      continue;
+    std::vector<std::thread> pool;
+    for (unsigned t = 1; t < threads; ++t)
+      pool.push_back(std::thread([&rows, &list, &expired, window, threads,
+				  t]() {
+	    for (std::size_t i = t * list.size() / threads;
+		 i < (t+1) * list.size() / threads; ++i) {
+	      if (i % 64 == 0 && expired())
+		break;
+	      bestOrder(rows, list[i], window);
+	    }
+	  }));
+    for (std::size_t i = 0; i < list.size() / threads; ++i) {
+      if (i % 64 == 0 && expired())
+	break;
+      bestOrder(rows, list[i], window);
+    }
+    for (auto& t : pool)
+      t.join();
+    // neighbouring windows may share nets, check the gain again
+    // windows left when the budget runs out keep their order
+    for (std::size_t i = 0; i < list.size(); ++i) {
+      proposal& p = list[i];
+      if (i % 64 == 0 && expired())
+	break;
+      if (p.gain <= DETAIL_EPS)
+	continue;
+      bestOrder(rows, p, window);
+      if (p.gain > DETAIL_EPS) {
+	applyOrder(rows, p, window);
+	total_gain += p.gain;
+      }
+    }
+  }
+  return total_gain;
+}
+
+// swap equal width cells that share no net into their best slots
+// the assignment is solved exactly with a DP over subsets of slots
+double independentSetMatch(std::vector<row*>& rows,
+			   const std::vector<node*>& nodes)
+{
+  // row and index of every cell
+  std::unordered_map<node*, std::pair<std::size_t, std::size_t> > where;
+  for (std::size_t r = 0; r < rows.size(); ++r)
+    for (std::size_t i = 0; i < rows[r]->size(); ++i)
+      where[(*rows[r])[i]] = std::make_pair(r, i);
+  std::vector<node*> order(nodes);
+  std::sort(order.begin(), order.end(), [](node *a, node *b) {
+      if (a->getDoubleWidth() != b->getDoubleWidth())
+	return a->getDoubleWidth() < b->getDoubleWidth();
+      if (a->getDoubleX() != b->getDoubleX())
+	return a->getDoubleX() < b->getDoubleX();
+      return a->getY() < b->getY();
+    });
+  std::unordered_map<node*, bool> used;
+  double total_gain = 0.0;
+  for (std::size_t seed = 0; seed < order.size(); ++seed) {
+    if (used[order[seed]])
+      continue;
+    // pick independent cells of the same width close to the seed
+    std::vector<node*> set;
+    set.push_back(order[seed]);
+    used[order[seed]] = true;
+    for (std::size_t j = seed + 1; j < order.size()
+	   && j < seed + 4 * ISM_SIZE && set.size() < ISM_SIZE; ++j) {
+      node *cand = order[j];
+      if (cand->getDoubleWidth() != order[seed]->getDoubleWidth())
+	break;
+      if (used[cand])
+	continue;
+      bool ok = true;
+      for (auto i : set)
+	ok = ok && independent(i, cand);
+      if (ok) {
+	set.push_back(cand);
+	used[cand] = true;
+      }
+    }
+    int n = set.size();
+    if (n < 2)
+      continue;
+    // cost[i][j]: nets of cell i with the cell at slot j
+    std::vector<std::vector<double> > cost(n, std::vector<double>(n));
+    for (int i = 0; i < n; ++i) {
+      std::vector<node*> nets;
+      collectNets(set[i], nets);
+      uniqueNets(nets);
+      for (int j = 0; j < n; ++j) {
+	location moved = {set[i], set[j]->getDoubleX(), set[j]->getY()};
+	cost[i][j] = netsCost(nets, &moved, 1);
+      }
+    }
+    // dp[mask]: best cost of the first popcount(mask) cells in mask
+    std::vector<double> dp(1 << n, std::numeric_limits<double>::max());
+    std::vector<int> from(1 << n, -1);
+    dp[0] = 0.0;
+    for (int mask = 0; mask < (1 << n); ++mask) {
+      if (dp[mask] == std::numeric_limits<double>::max())
+	continue;
+      int i = __builtin_popcount(mask);
+      if (i == n)
+	continue;
+      for (int j = 0; j < n; ++j) {
+	if (mask & (1 << j))
+	  continue;
+	double c = dp[mask] + cost[i][j];
+	if (c < dp[mask | (1 << j)] - DETAIL_EPS) {
+	  dp[mask | (1 << j)] = c;
+	  from[mask | (1 << j)] = j;
+	}
+      }
+    }
+    double base = 0.0;
+    for (int i = 0; i < n; ++i)
+      base += cost[i][i];
+    int full = (1 << n) - 1;
+    if (dp[full] >= base - DETAIL_EPS)
+      continue;
+    total_gain += base - dp[full];
+    // recover the slot of every cell and move them
+    std::vector<int> slot(n);
+    for (int mask = full, i = n - 1; i >= 0; --i) {
+      slot[i] = from[mask];
+      mask &= ~(1 << slot[i]);
+    }
+    std::vector<location> target(n);
+    std::vector<std::pair<std::size_t, std::size_t> > index(n);
+    for (int j = 0; j < n; ++j) {
+      target[j] = {set[j], set[j]->getDoubleX(), set[j]->getY()};
+      index[j] = where[set[j]];
+    }
+    for (int i = 0; i < n; ++i) {
+      int j = slot[i];
+      rows[index[j].first]->setElement(index[j].second, set[i]);
+      set[i]->setDoubleX(target[j].dX);
+      set[i]->setY(target[j].Y);
+      where[set[i]] = index[j];
+    }
+  }
+  return total_gain;
+}
+
+// move single cells to the median of their neighbours when the target
+// row has whitespace left
+double cellRelocate(std::vector<row*>& rows,
+		    const std::vector<node*>& nodes)
+{
+  double total_gain = 0.0;
+  for (auto cell : nodes) {
+    std::vector<int> xs, ys;
+    for (auto i : cell->getFanin()) {
+      xs.push_back(i->getDoubleX());
+      ys.push_back(i->getY());
+    }
+    for (auto i : cell->getFanout()) {
+      xs.push_back(i->getDoubleX());
+      ys.push_back(i->getY());
+    }
+    if (xs.empty())
+      continue;
+    std::nth_element(xs.begin(), xs.begin() + xs.size()/2, xs.end());
+    std::nth_element(ys.begin(), ys.begin() + ys.size()/2, ys.end());
+    int tx = xs[xs.size()/2], ty = ys[ys.size()/2];
+    std::size_t src = cell->getY() - 1, dst = ty - 1;
+    if (src == dst || dst >= rows.size()
+	|| rows[dst]->getSum() + cell->getDoubleWidth() > rows[dst]->getLimit())
+      continue;
+    const std::vector<node*>& src_cells = rows[src]->getCells();
+    std::size_t from = std::find(src_cells.begin(), src_cells.end(), cell)
+      - src_cells.begin();
+    const std::vector<node*>& dst_cells = rows[dst]->getCells();
+    std::size_t to = 0;
+    while (to < dst_cells.size() && dst_cells[to]->getDoubleX() < tx)
+      ++to;
+    // nets of every cell that moves, including the shifted ones
+    std::vector<node*> nets;
+    for (std::size_t i = from; i < src_cells.size(); ++i)
+      collectNets(src_cells[i], nets);
+    for (std::size_t i = to; i < dst_cells.size(); ++i)
+      collectNets(dst_cells[i], nets);
+    uniqueNets(nets);
+    double before = netsCost(nets, nullptr, 0);
+    // swaps during annealing do not check the width limit, so the
+    // source row may not take the cell back, restore copies instead
+    std::vector<node*> old_src(src_cells), old_dst(dst_cells);
+    rows[src]->erase(from);
+    rows[dst]->insert(to, cell);
+    rows[src]->setCoordinate(src + 1);
+    rows[dst]->setCoordinate(dst + 1);
+    double after = netsCost(nets, nullptr, 0);
+    if (after < before - DETAIL_EPS) {
+      total_gain += before - after;
+    } else { // put it back
+      rows[src]->setCells(old_src);
+      rows[dst]->setCells(old_dst);
+      rows[src]->setCoordinate(src + 1);
+      rows[dst]->setCoordinate(dst + 1);
+    }
+  }
+  return total_gain;
+}
+
+// deterministic greedy post-pass after annealing
+// with a time budget (seconds, 0 means unlimited) a pass only starts
+// when one more pass as long as the last one still fits, and the
+// reordering of the first pass stops at the end of the budget
+double detailedPlacement(std::vector<row*>& rows,
+			 const std::vector<node*>& nodes,
+			 int window, unsigned threads, double timeBudget)
+{
+  typedef std::chrono::steady_clock Time;
+  auto start = Time::now(), passStart = start;
+  double HPWL = layoutHPWL(rows);
+  if (enableVerbose)
+    std::cout << "Detailed placement from HPWL:" << HPWL << std::endl;
+  for (int pass = 0; pass < 10; ++pass) {
+    std::chrono::duration<double> used = Time::now() - start;
+    std::chrono::duration<double> last = Time::now() - passStart;
+    if (timeBudget > 0 && pass && used.count() + last.count() > timeBudget)
+      break;
+    passStart = Time::now();
+    double left = timeBudget > 0
+      ? std::max(timeBudget - used.count(), 1e-3) : 0.0;
+    double reorder = windowReorder(rows, window, threads, left);
+    double ism = independentSetMatch(rows, nodes);
+    double reloc = cellRelocate(rows, nodes);
+    if (enableVerbose)
+      std::cout << "Pass " << pass << " reorder gain:" << reorder
+		<< " matching gain:" << ism
+		<< " relocation gain:" << reloc << std::endl;
+    double gain = reorder + ism + reloc;
+    if (gain < 1e-3 * HPWL)
+      break;
+    HPWL -= gain;
+  }
+  HPWL = layoutHPWL(rows);
+  if (enableVerbose)
+    std::cout << "Detailed placement HPWL:" << HPWL << std::endl;
+  return HPWL;
+}
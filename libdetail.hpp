@@ -0,0 +1,24 @@
+#ifndef LIBDETAIL_HPP
+#define LIBDETAIL_HPP
+
+#include <vector>
+
+#include "libckt.hpp"
+#include "librow.hpp"
+
+// largest window for exact reordering, 6! permutations per window
+#define MAX_WINDOW 6
+// cells matched together by independent set matching
+#define ISM_SIZE 8
+
+double windowReorder(std::vector<row*>& rows, int window, unsigned threads,
+		     double timeBudget);
+double independentSetMatch(std::vector<row*>& rows,
+			   const std::vector<node*>& nodes);
+double cellRelocate(std::vector<row*>& rows,
+		    const std::vector<node*>& nodes);
+double detailedPlacement(std::vector<row*>& rows,
+			 const std::vector<node*>& nodes,
+			 int window, unsigned threads, double timeBudget);
+
+#endif
@@ -0,0 +1,479 @@
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <map>
+#include <set>
+#include <random>
+#include <chrono>
+#include <algorithm>
+#include <exception>
+
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#include <cerrno>
+
+#include "libckt.hpp"
+#include "librow.hpp"
+#include "libdetail.hpp"
+#include "libeco.hpp"
+#include "util.hpp"
+
+extern thread_local std::mt19937 gen;
+
+namespace {
+
+void collectNets(node *cell, std::vector<node*>& nets)
+{
+  nets.push_back(cell);
+  for (auto i : cell->getFanin())
+    nets.push_back(i);
+}
+
+// HPWL of the nets of the cells moved by the journaled move
+double movedCost(const journal& jn, std::vector<node*>& nets)
+{
+  nets.clear();
+  for (std::size_t i = 0; i < jn.coordCount(); ++i)
+    collectNets(jn.coordCell(i), nets);
+  std::sort(nets.begin(), nets.end());
+  nets.erase(std::unique(nets.begin(), nets.end()), nets.end());
+  double sum = 0.0;
+  for (auto i : nets)
+    sum += i->netHPWLCal();
+  return sum;
+}
+
+std::size_t indexInRow(row *r, node *cell)
+{
+  const std::vector<node*>& cells = r->getCells();
+  return std::find(cells.begin(), cells.end(), cell) - cells.begin();
+}
+
+// put a new cell at the median of its fanins, in the closest row with
+// room, or the emptiest row if none has room
+void placeCell(placedCkt& ckt, node *cell)
+{
+  std::vector<int> xs, ys;
+  for (auto i : cell->getFanin()) {
+    if (i->fPosition()) {
+      xs.push_back(i->getDoubleX());
+      ys.push_back(i->getY());
+    }
+  }
+  int height = ckt.rows.size();
+  int tx = 0, tr = height / 2;
+  if (!xs.empty()) {
+    std::nth_element(xs.begin(), xs.begin() + xs.size()/2, xs.end());
+    std::nth_element(ys.begin(), ys.begin() + ys.size()/2, ys.end());
+    tx = xs[xs.size()/2];
+    tr = std::min(height - 1, std::max(0, ys[ys.size()/2] - 1));
+  }
+  int r = -1;
+  for (int d = 0; d < height && r < 0; ++d) {
+    for (int cand : {tr + d, tr - d}) {
+      if (cand < 0 || cand >= height)
+	continue;
+      if (ckt.rows[cand]->getSum() + cell->getDoubleWidth()
+	  <= ckt.rows[cand]->getLimit()) {
+	r = cand;
+	break;
+      }
+    }
+  }
+  bool force = (r < 0);
+  if (force) {
+    r = 0;
+    for (int i = 1; i < height; ++i)
+      if (ckt.rows[i]->getSum() < ckt.rows[r]->getSum())
+	r = i;
+  }
+  const std::vector<node*>& cells = ckt.rows[r]->getCells();
+  std::size_t to = 0;
+  while (to < cells.size() && cells[to]->getDoubleX() < tx)
+    ++to;
+  if (force) { // the layout grows, like swaps during annealing can
+    std::vector<node*> grown(cells);
+    grown.insert(grown.begin() + to, cell);
+    ckt.rows[r]->setCells(grown);
+  } else {
+    ckt.rows[r]->insert(to, cell);
+  }
+  ckt.rows[r]->setCoordinate(r + 1);
+}
+
+// the width follows the fanin count, shift the rest of its row
+void resize(placedCkt& ckt, node *cell)
+{
+  cell->updateWidth();
+  if (cell->fPosition() && !ckt.rows.empty())
+    ckt.rows[cell->getY() - 1]->setCoordinate(cell->getY());
+}
+
+node *findCell(placedCkt& ckt, const std::string& name)
+{
+  return ::findCell(ckt.circuit, name);
+}
+
+// full placement, the same flow as place without the files
+double placeCkt(placedCkt& ckt, const std::vector<std::string>& args)
+{
+  schedule sch;
+  int window = 0;
+  for (std::size_t i = 2; i + 1 < args.size(); ++i) {
+    if (args[i] == "--move-budget")
+      sch.moveBudget = std::stoll(args[++i]);
+    else if (args[i] == "--time-budget")
+      sch.timeBudget = std::stod(args[++i]);
+    else if (args[i] == "--detail") {
+      window = std::stoi(args[++i]);
+      sch.frzTemp = DETAIL_FRZ_TEMP;
+    }
+  }
+  initialPlacement(ckt.nodes, ckt.rows);
+  setCoordinate(ckt.rows);
+  double HPWL = layoutHPWL(ckt.rows);
+  ckt.k = kboltz(ckt.rows, sch);
+  sch.num_moves = ckt.nodes.size();
+  // the post-pass gets its share of the time budget
+  double detailBudget = window ? DETAIL_TIME_SHARE * sch.timeBudget : 0.0;
+  sch.timeBudget -= detailBudget;
+  if (sch.timeBudget > 0 || sch.moveBudget > 0)
+    planSchedule(sch, measurePolicyRate(ckt.rows, 50, sch));
+  std::ostream steps(nullptr);
+  HPWL = annealing(ckt.rows, ckt.k, HPWL, sch, steps);
+  if (window)
+    HPWL = detailedPlacement(ckt.rows, ckt.nodes, window, 1,
+			     detailBudget);
+  ckt.dirty.clear();
+  return HPWL;
+}
+
+// all of data to a client, false once it is gone. MSG_NOSIGNAL keeps a
+// client that hung up from killing the server with SIGPIPE
+bool sendAll(int client, const std::string& data)
+{
+  std::size_t sent = 0;
+  while (sent < data.size()) {
+    ssize_t n = send(client, data.data() + sent, data.size() - sent,
+		     MSG_NOSIGNAL);
+    if (n < 0 && errno == EINTR)
+      continue;
+    if (n <= 0)
+      return false;
+    sent += n;
+  }
+  return true;
+}
+
+} // namespace
+
+// add "name = type(fanin...)" and place it next to its fanins
+bool ecoAddGate(placedCkt& ckt, const std::string& name,
+		const std::string& type,
+		const std::vector<std::string>& fanin)
+{
+  if (findCell(ckt, name) || parseType(type) == UNDEF)
+    return false;
+  std::vector<node*> drivers;
+  for (const auto& i : fanin) {
+    node *driver = findCell(ckt, i);
+    if (!driver)
+      return false;
+    drivers.push_back(driver);
+  }
+  node *cell = new node(name, type);
+  for (auto i : drivers) {
+    cell->pushFanin(i);
+    i->pushFanout(cell);
+    ckt.dirty.insert(i);
+  }
+  cell->setWidth();
+  ckt.circuit.insert(std::make_pair(cell->getNameId(), cell));
+  ckt.nodes.push_back(cell);
+  if (!ckt.rows.empty())
+    placeCell(ckt, cell);
+  ckt.dirty.insert(cell);
+  return true;
+}
+
+// remove a gate and every edge to it
+bool ecoRemoveGate(placedCkt& ckt, const std::string& name)
+{
+  node *cell = findCell(ckt, name);
+  if (!cell)
+    return false;
+  for (auto i : cell->getFanin()) {
+    i->removeFanout(cell);
+    ckt.dirty.insert(i);
+  }
+  std::vector<node*> fanout(cell->getFanout());
+  for (auto i : fanout) {
+    i->removeFanin(cell);
+    resize(ckt, i);
+    ckt.dirty.insert(i);
+  }
+  if (cell->fPosition() && !ckt.rows.empty()) {
+    row *r = ckt.rows[cell->getY() - 1];
+    r->erase(indexInRow(r, cell));
+    r->setCoordinate(cell->getY());
+  }
+  ckt.circuit.erase(cell->getNameId());
+  ckt.nodes.erase(std::find(ckt.nodes.begin(), ckt.nodes.end(), cell));
+  for (auto i : {&ckt.inputs, &ckt.outputs}) {
+    auto iter = std::find(i->begin(), i->end(), cell);
+    if (iter != i->end())
+      i->erase(iter);
+  }
+  ckt.dirty.erase(cell);
+  node::doublearea -= cell->getDoubleWidth();
+  delete cell;
+  return true;
+}
+
+// add or remove the edge fanin -> name
+bool ecoConnect(placedCkt& ckt, const std::string& name,
+		const std::string& fanin, bool connect)
+{
+  node *cell = findCell(ckt, name), *driver = findCell(ckt, fanin);
+  if (!cell || !driver)
+    return false;
+  const std::vector<node*>& inputs = cell->getFanin();
+  bool exists = std::find(inputs.begin(), inputs.end(), driver)
+    != inputs.end();
+  if (connect == exists)
+    return false;
+  if (connect) {
+    cell->pushFanin(driver);
+    driver->pushFanout(cell);
+  } else {
+    cell->removeFanin(driver);
+    driver->removeFanout(cell);
+  }
+  resize(ckt, cell);
+  ckt.dirty.insert(cell);
+  ckt.dirty.insert(driver);
+  return true;
+}
+
+// short low temperature anneal around the cells touched by ECOs
+// a move swaps a touched cell or a neighbour of one with a cell
+// close to it, the cost is only evaluated on the nets of the cells
+// the swap moved, so the rest of the layout is never visited
+int ecoReplace(placedCkt& ckt)
+{
+  std::vector<node*> region;
+  for (auto i : ckt.dirty) {
+    region.push_back(i);
+    for (auto j : i->getFanin())
+      region.push_back(j);
+    for (auto j : i->getFanout())
+      region.push_back(j);
+  }
+  std::sort(region.begin(), region.end());
+  region.erase(std::unique(region.begin(), region.end()), region.end());
+  // deterministic order, pointers are not
+  std::sort(region.begin(), region.end(), [](node *a, node *b) {
+      return a->getY() < b->getY()
+	|| (a->getY() == b->getY() && a->getDoubleX() < b->getDoubleX());
+    });
+  ckt.dirty.clear();
+  if (region.empty() || ckt.rows.empty())
+    return 0;
+  int height = ckt.rows.size();
+  journal jn;
+  std::vector<node*> nets;
+  int accepted = 0;
+  int num_moves = ECO_MOVES_PER_CELL * region.size();
+  for (double T = ECO_MAX_TEMP; T > ECO_FRZ_TEMP; T *= ECO_COOL_RATE) {
+    for (int m = 0; m < num_moves; ++m) {
+      node *a = region[gen() % region.size()];
+      int row_idx1 = a->getY() - 1;
+      int itm_idx1 = indexInRow(ckt.rows[row_idx1], a);
+      int row_idx2 = row_idx1 + int(gen() % (2*ECO_RADIUS + 1)) - ECO_RADIUS;
+      if (row_idx2 < 0 || row_idx2 >= height || !ckt.rows[row_idx2]->size())
+	continue;
+      int itm_idx2 = itm_idx1 + int(gen() % (2*ECO_RADIUS + 1)) - ECO_RADIUS;
+      itm_idx2 = std::min(std::max(itm_idx2, 0),
+			  int(ckt.rows[row_idx2]->size()) - 1);
+      if (row_idx1 == row_idx2 && itm_idx1 == itm_idx2)
+	continue;
+      swap(ckt.rows, row_idx1, itm_idx1, row_idx2, itm_idx2, jn);
+      double after = movedCost(jn, nets);
+      // same nets before the move
+      jn.rollback(ckt.rows);
+      double before = 0.0;
+      for (auto i : nets)
+	before += i->netHPWLCal();
+      if (accept_move(after - before, ckt.k, T)) {
+	swap(ckt.rows, row_idx1, itm_idx1, row_idx2, itm_idx2, jn);
+	++accepted;
+      }
+      jn.clear();
+    }
+  }
+  return accepted;
+}
+
+// one command of the server protocol, the answer starts with ok or error
+//   load <name> <file.bench>      place <name> [options of place]
+//   add <name> <gate> <type> <fanin>...
+//   remove <name> <gate>          connect|disconnect <name> <gate> <fanin>
+//   replace <name>                hpwl <name>
+//   write <name> <file>           unload <name>        quit
+std::string serveCommand(std::map<std::string, placedCkt*>& ckts,
+			 const std::string& line, bool& quit)
+{
+  typedef std::chrono::steady_clock Time;
+  std::vector<std::string> args;
+  parseLine(line, args, " \t\r");
+  if (args.empty())
+    return "";
+  std::ostringstream ans;
+  auto start = Time::now();
+  const std::string& cmd = args.front();
+  if (cmd == "quit") {
+    quit = true;
+    return "ok bye";
+  }
+  if (args.size() < 2)
+    return "error missing circuit name";
+  auto search = ckts.find(args[1]);
+  placedCkt *ckt = (search == ckts.end()) ? nullptr : search->second;
+  if (cmd == "load") {
+    if (ckt || args.size() < 3)
+      return "error usage: load <new name> <file>";
+    std::ifstream file(args[2]);
+    if (!file.is_open())
+      return "error failed to open " + args[2];
+    ckt = new placedCkt;
+    parseCkt(file, ckt->inputs, ckt->outputs, ckt->nodes, ckt->circuit);
+    ckts[args[1]] = ckt;
+    ans << "ok " << ckt->nodes.size() << " cells";
+    return ans.str();
+  }
+  if (!ckt)
+    return "error unknown circuit " + args[1];
+  if (cmd == "place") {
+    double HPWL = placeCkt(*ckt, args);
+    ans << "ok hpwl " << HPWL;
+  } else if (cmd == "add" && args.size() >= 4) {
+    std::vector<std::string> fanin(args.begin() + 4, args.end());
+    if (!ecoAddGate(*ckt, args[2], args[3], fanin))
+      return "error cannot add " + args[2];
+    ans << "ok";
+  } else if (cmd == "remove" && args.size() == 3) {
+    if (!ecoRemoveGate(*ckt, args[2]))
+      return "error cannot remove " + args[2];
+    ans << "ok";
+  } else if ((cmd == "connect" || cmd == "disconnect") && args.size() == 4) {
+    if (!ecoConnect(*ckt, args[2], args[3], cmd == "connect"))
+      return "error cannot " + cmd + " " + args[3] + " to " + args[2];
+    ans << "ok";
+  } else if (cmd == "replace") {
+    if (ckt->k == 0.0)
+      return "error " + args[1] + " is not placed";
+    int accepted = ecoReplace(*ckt);
+    std::chrono::duration<double, std::milli> ms = Time::now() - start;
+    ans << "ok hpwl " << layoutHPWL(ckt->rows) << " moves " << accepted
+	<< " ms " << ms.count();
+  } else if (cmd == "hpwl") {
+    ans << "ok hpwl " << layoutHPWL(ckt->rows);
+  } else if (cmd == "write" && args.size() == 3) {
+    std::ofstream file(args[2]);
+    if (!file.is_open())
+      return "error failed to open " + args[2];
+    double HPWL = layoutHPWL(ckt->rows);
+    annealingStatistics(file, ckt->rows, ckt->nodes, HPWL);
+    ans << "ok";
+  } else if (cmd == "unload") {
+    destroy(ckt->rows);
+    for (auto i : ckt->nodes)
+      delete i;
+    delete ckt;
+    ckts.erase(search);
+    ans << "ok";
+  } else {
+    return "error unknown command " + cmd;
+  }
+  return ans.str();
+}
+
+// answer commands read line by line until quit or end of input
+int serveStream(std::istream& in, std::ostream& out)
+{
+  std::map<std::string, placedCkt*> ckts;
+  std::string line;
+  bool quit = false;
+  enableVerbose = false; // stdout carries the answers
+  while (!quit && std::getline(in, line)) {
+    std::string answer;
+    try {
+      answer = serveCommand(ckts, line, quit);
+    } catch (const std::exception& e) {
+      answer = std::string("error ") + e.what();
+    }
+    if (!answer.empty())
+      out << answer << std::endl;
+  }
+  return 0;
+}
+
+// same protocol on a unix socket, one client at a time, circuits stay
+// loaded between clients
+int serveSocket(const std::string& path)
+{
+  int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+  if (fd < 0)
+    return 1;
+  sockaddr_un addr = {};
+  addr.sun_family = AF_UNIX;
+  if (path.size() >= sizeof(addr.sun_path))
+    return 1;
+  std::copy(path.begin(), path.end(), addr.sun_path);
+  unlink(path.c_str());
+  if (bind(fd, (sockaddr*)&addr, sizeof(addr)) < 0 || listen(fd, 4) < 0) {
+    close(fd);
+    return 1;
+  }
+  enableVerbose = false;
+  std::map<std::string, placedCkt*> ckts;
+  bool quit = false;
+  while (!quit) {
+    int client = accept(fd, nullptr, nullptr);
+    if (client < 0)
+      break;
+    std::string pending;
+    char buffer[4096];
+    ssize_t n;
+    bool connected = true;
+    while (connected && !quit
+	   && (n = read(client, buffer, sizeof(buffer))) > 0) {
+      pending.append(buffer, n);
+      std::size_t end;
+      while (!quit && (end = pending.find('\n')) != std::string::npos) {
+	std::string line = pending.substr(0, end);
+	pending.erase(0, end + 1);
+	std::string answer;
+	try {
+	  answer = serveCommand(ckts, line, quit);
+	} catch (const std::exception& e) {
+	  answer = std::string("error ") + e.what();
+	}
+	if (answer.empty())
+	  continue;
+	answer += "\n";
+	if (!sendAll(client, answer)) {
+	  connected = false;
+	  break;
+	}
+      }
+    }
+    close(client);
+  }
+  close(fd);
+  unlink(path.c_str());
+  return 0;
+}
@@ -0,0 +1,45 @@
+#ifndef LIBECO_HPP
+#define LIBECO_HPP
+
+#include <iostream>
+#include <string>
+#include <vector>
+#include <map>
+#include <set>
+
+#include "libckt.hpp"
+#include "librow.hpp"
+
+// schedule of the local anneal after an ECO
+#define ECO_MAX_TEMP 20.0
+#define ECO_FRZ_TEMP 1.0
+#define ECO_COOL_RATE 0.8
+#define ECO_MOVES_PER_CELL 20
+// partners of a move are taken within this many rows and slots
+#define ECO_RADIUS 3
+
+// a netlist kept in memory with its placement
+struct placedCkt {
+  std::vector<node*> inputs, outputs, nodes;
+  cellMap circuit;
+  std::vector<row*> rows;
+  // k of the full placement, 0 before the first place
+  double k = 0.0;
+  // cells touched by ECOs since the last replace
+  std::set<node*> dirty;
+};
+
+bool ecoAddGate(placedCkt& ckt, const std::string& name,
+		const std::string& type,
+		const std::vector<std::string>& fanin);
+bool ecoRemoveGate(placedCkt& ckt, const std::string& name);
+bool ecoConnect(placedCkt& ckt, const std::string& name,
+		const std::string& fanin, bool connect);
+int ecoReplace(placedCkt& ckt);
+
+std::string serveCommand(std::map<std::string, placedCkt*>& ckts,
+			 const std::string& line, bool& quit);
+int serveStream(std::istream& in, std::ostream& out);
+int serveSocket(const std::string& path);
+
+#endif
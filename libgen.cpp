@@ -0,0 +1,173 @@
+#include <iostream>
+#include <vector>
+#include <random>
+#include <cmath>
+#include <cstdint>
+#include <algorithm>
+
+#include "libgen.hpp"
+
+namespace {
+
+// distributions of the standard library are implementation defined,
+// draw everything from the raw engine so that a seed gives the same
+// netlist everywhere
+class genRandom {
+private:
+  std::mt19937_64 engine;
+public:
+  genRandom(std::uint64_t seed): engine(seed) {}
+  // uniform in [0, 1)
+  double uniform() {
+    return (engine() >> 11) * (1.0 / 9007199254740992.0);
+  }
+  // uniform in [0, n)
+  long long index(long long n) {
+    return (long long)(uniform() * n);
+  }
+  // number of trials until success with the given mean, at least 1
+  int geometric(double mean) {
+    if (mean <= 1.0)
+      return 1;
+    double p = 1.0 / mean;
+    return 1 + (int)std::floor(std::log(1.0 - uniform()) / std::log(1.0 - p));
+  }
+  // heavy tailed distance, P(D > d) = d^-beta, less one and modulo
+  // period. the draw is reduced while still a double, so a tail past
+  // the range of long long cannot overflow
+  long long pareto(double beta, long long period) {
+    double d = std::floor(std::pow(1.0 - uniform(), -1.0 / beta));
+    if (!std::isfinite(d))
+      return 0;
+    return (long long)std::fmod(d, double(period)) - 1;
+  }
+};
+
+struct gateKind {
+  const char *name;
+  int fanin;
+  double weight;
+};
+
+// roughly the mix of gates found in the ISCAS85 benchmarks
+const gateKind kinds[] = {
+  {"NAND", 2, 0.22}, {"AND", 2, 0.21}, {"NOR", 2, 0.18},
+  {"NOT", 1, 0.20}, {"BUFF", 1, 0.11}, {"OR", 2, 0.05},
+  {"XOR", 2, 0.02}, {"XNOR", 2, 0.01}
+};
+
+const gateKind& pickKind(genRandom& rnd)
+{
+  double r = rnd.uniform();
+  for (const auto& k : kinds) {
+    if (r < k.weight)
+      return k;
+    r -= k.weight;
+  }
+  return kinds[0];
+}
+
+void printName(std::ostream& out, long long id, long long inputs)
+{
+  if (id < inputs)
+    out << "I" << id;
+  else
+    out << "N" << id - inputs;
+}
+
+} // namespace
+
+// write a levelized random netlist in .bench format
+// gates of a level take their first input from the level before, so
+// the logic depth is exact, the other inputs come from any earlier
+// level. a driver is looked for around the same relative position in
+// its level, at a Pareto distributed distance whose tail gets heavier
+// as the Rent exponent grows, drivers that already reached their
+// fanout target are skipped if possible
+int generateCkt(std::ostream& out, const genParams& param)
+{
+  genRandom rnd(param.seed);
+  long long cells = std::max(1LL, param.cells);
+  int depth = std::max(1, (int)std::min<long long>(param.depth, cells));
+  double rent = std::min(std::max(param.rent, 0.05), 0.95);
+  double beta = 2.0 * (1.0 - rent);
+  // Rent's rule T = t * N^p with about 3 pins per gate
+  long long inputs = std::max(2LL, (long long)(1.5 * std::pow(cells, rent)));
+
+  // first id of every level, level 0 are the primary inputs
+  std::vector<long long> level(depth + 2);
+  level[0] = 0;
+  level[1] = inputs;
+  for (int l = 1; l <= depth; ++l)
+    level[l+1] = inputs + cells * l / depth;
+  long long total = level[depth+1];
+  std::vector<int> target(total), used(total, 0);
+  for (auto& t : target)
+    t = rnd.geometric(param.fanout);
+
+  out << "# synthetic netlist" << std::endl
+      << "# " << cells << " gates, rent " << rent
+      << ", fanout " << param.fanout << ", depth " << depth
+      << ", seed " << param.seed << std::endl << std::endl;
+  for (long long i = 0; i < inputs; ++i) {
+    out << "INPUT(";
+    printName(out, i, inputs);
+    out << ")\n";
+  }
+  out << "\n";
+
+  std::vector<long long> fanin;
+  for (int l = 1; l <= depth; ++l) {
+    long long size = level[l+1] - level[l];
+    for (long long g = level[l]; g < level[l+1]; ++g) {
+      const gateKind& kind = pickKind(rnd);
+      int n = kind.fanin;
+      if (n == 2 && rnd.uniform() < 0.2)
+	++n; // some wider gates
+      double pos = double(g - level[l]) / size;
+      fanin.clear();
+      for (int k = 0; k < n; ++k) {
+	int from = (k == 0) ? l - 1 : (int)rnd.index(l);
+	long long first = level[from], lsize = level[from+1] - first;
+	long long pick = -1;
+	for (int attempt = 0; attempt < 4 && pick < 0; ++attempt) {
+	  long long d = rnd.pareto(beta, lsize);
+	  if (rnd.uniform() < 0.5)
+	    d = -d;
+	  long long idx = (long long)(pos * lsize) + d;
+	  idx = ((idx % lsize) + lsize) % lsize;
+	  long long cand = first + idx;
+	  if (used[cand] < target[cand]
+	      && std::find(fanin.begin(), fanin.end(), cand) == fanin.end())
+	    pick = cand;
+	}
+	if (pick < 0) // all tried drivers are full, take any
+	  pick = first + rnd.index(lsize);
+	if (std::find(fanin.begin(), fanin.end(), pick) != fanin.end())
+	  continue;
+	++used[pick];
+	fanin.push_back(pick);
+      }
+      printName(out, g, inputs);
+      out << " = " << (fanin.size() == 1 && n > 1 ? "BUFF" : kind.name)
+	  << "(";
+      for (std::size_t k = 0; k < fanin.size(); ++k) {
+	if (k)
+	  out << ", ";
+	printName(out, fanin[k], inputs);
+      }
+      out << ")\n";
+    }
+  }
+  out << "\n";
+  // every gate nobody reads drives a primary output
+  for (long long g = inputs; g < total; ++g) {
+    if (used[g])
+      continue;
+    out << "OUTPUT(";
+    printName(out, g, inputs);
+    out << ")\n";
+  }
+  out.flush();
+  return 0;
+}
@@ -0,0 +1,22 @@
+#ifndef LIBGEN_HPP
+#define LIBGEN_HPP
+
+#include <iostream>
+#include <cstdint>
+
+// parameters of a synthetic netlist
+struct genParams {
+  // number of gates, primary inputs and outputs come on top
+  long long cells = 10000;
+  // Rent exponent, controls how local the connections are
+  double rent = 0.6;
+  // mean fanout of a gate (geometric distribution)
+  double fanout = 2.0;
+  // number of logic levels
+  int depth = 30;
+  std::uint64_t seed = 1;
+};
+
+int generateCkt(std::ostream& out, const genParams& param);
+
+#endif
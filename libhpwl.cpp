@@ -0,0 +1,259 @@
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <unordered_map>
+#include <algorithm>
+#include <cstdint>
+#include <cmath>
+
+#include "libckt.hpp"
+#include "librow.hpp"
+#include "libhpwl.hpp"
+
+// every cell in the rows drives one net made of itself and its fanout,
+// the same nets node::netHPWLCal() sees
+hpwlEngine::hpwlEngine(const std::vector<row*>& rows, unsigned nthreads)
+  : threads(std::max(1u, nthreads))
+{
+  auto id = [&](node *cell) {
+    auto search = index.find(cell);
+    if (search != index.end())
+      return search->second;
+    int ans = cells.size();
+    index[cell] = ans;
+    cells.push_back(cell);
+    return ans;
+  };
+  std::vector<std::vector<int> > nets;
+  for (auto r : rows) {
+    for (auto driver : r->getCells()) {
+      std::vector<int> net;
+      net.push_back(id(driver));
+      for (auto i : driver->getFanout())
+	net.push_back(id(i));
+      if (net.size() > 1)
+	nets.push_back(net);
+    }
+  }
+  std::vector<std::size_t> count(HPWL_MAX_GROUP + 1, 0);
+  for (const auto& i : nets)
+    if (i.size() <= HPWL_MAX_GROUP)
+      ++count[i.size()];
+  std::vector<int> slot(HPWL_MAX_GROUP + 1, -1);
+  for (int d = 2; d <= HPWL_MAX_GROUP; ++d) {
+    if (!count[d])
+      continue;
+    slot[d] = groups.size();
+    groups.push_back({d, count[d],
+	  std::vector<int>(std::size_t(d) * count[d])});
+  }
+  std::vector<std::size_t> filled(HPWL_MAX_GROUP + 1, 0);
+  bigStart.push_back(0);
+  for (const auto& i : nets) {
+    int d = i.size();
+    if (d > HPWL_MAX_GROUP) {
+      bigPins.insert(bigPins.end(), i.begin(), i.end());
+      bigStart.push_back(bigPins.size());
+      continue;
+    }
+    group& g = groups[slot[d]];
+    for (int j = 0; j < d; ++j)
+      g.pins[j * g.count + filled[d]] = i[j];
+    ++filled[d];
+  }
+  dX.resize(cells.size());
+  Y.resize(cells.size());
+  weight.assign(cells.size(), HPWL_WEIGHT_ONE);
+  gather();
+}
+
+hpwlEngine::~hpwlEngine()
+{
+  {
+    std::lock_guard<std::mutex> guard(lock);
+    stopping = true;
+  }
+  wake.notify_all();
+  for (auto& t : workers)
+    t.join();
+}
+
+// run job on one part per round until the engine goes away
+void hpwlEngine::work(unsigned part)
+{
+  unsigned long seen = 0;
+  std::unique_lock<std::mutex> guard(lock);
+  for (;;) {
+    wake.wait(guard, [&]() {
+	return stopping || round != seen;
+      });
+    if (stopping)
+      return;
+    seen = round;
+    guard.unlock();
+    partial[part] = (this->*job)(part, threads, wpartial[part]);
+    guard.lock();
+    if (!--pending)
+      done.notify_one();
+  }
+}
+
+// weight of the net driven by cell, compute() then also returns the
+// weighted sum
+void hpwlEngine::setWeight(node *cell, double w)
+{
+  auto search = index.find(cell);
+  if (search == index.end())
+    return;
+  weight[search->second] = std::lround(w * HPWL_WEIGHT_ONE);
+  weighted = true;
+}
+
+// copy the coordinates out of all cells, after they were moved
+// without a journal
+void hpwlEngine::gather()
+{
+  for (std::size_t i = 0; i < cells.size(); ++i) {
+    dX[i] = cells[i]->getDoubleX();
+    Y[i] = cells[i]->getY() * node::dRowHeight;
+  }
+  touched.clear();
+}
+
+// copy the coordinates of the cells a move recorded in the journal
+void hpwlEngine::update(const journal& jn)
+{
+  touched.clear();
+  for (std::size_t i = 0; i < jn.coordCount(); ++i) {
+    auto search = index.find(jn.coordCell(i));
+    if (search == index.end())
+      continue;
+    int cell = search->second;
+    dX[cell] = cells[cell]->getDoubleX();
+    Y[cell] = cells[cell]->getY() * node::dRowHeight;
+    touched.push_back(cell);
+  }
+}
+
+// copy the cells of the last update() again after the journal rolled
+// them back
+void hpwlEngine::revert()
+{
+  for (auto cell : touched) {
+    dX[cell] = cells[cell]->getDoubleX();
+    Y[cell] = cells[cell]->getY() * node::dRowHeight;
+  }
+  touched.clear();
+}
+
+// length of part out of parts of every group under Metric, and the
+// same weighted in wsum when there are weights
+template <class Metric>
+std::int64_t hpwlEngine::reduce(unsigned part, unsigned parts,
+				std::int64_t& wsum) const
+{
+  const int *x = dX.data(), *y = Y.data(), *w = weight.data();
+  std::int64_t sum = 0;
+  wsum = 0;
+  int minX[HPWL_BLOCK], maxX[HPWL_BLOCK], minY[HPWL_BLOCK], maxY[HPWL_BLOCK];
+  int px[HPWL_BLOCK], py[HPWL_BLOCK];
+  for (const auto& g : groups) {
+    std::size_t first = g.count * part / parts;
+    std::size_t last = g.count * (part + 1) / parts;
+    for (std::size_t b = first; b < last; b += HPWL_BLOCK) {
+      std::size_t n = std::min<std::size_t>(HPWL_BLOCK, last - b);
+      const int *pin = g.pins.data() + b;
+      const int *drv = pin;
+      for (std::size_t m = 0; m < n; ++m) {
+	minX[m] = maxX[m] = x[pin[m]];
+	minY[m] = maxY[m] = y[pin[m]];
+      }
+      for (int j = 1; j < g.degree; ++j) {
+	pin += g.count;
+	// gather first, then the min/max loop is plain SIMD
+	for (std::size_t m = 0; m < n; ++m) {
+	  px[m] = x[pin[m]];
+	  py[m] = y[pin[m]];
+	}
+	for (std::size_t m = 0; m < n; ++m) {
+	  minX[m] = std::min(minX[m], px[m]);
+	  maxX[m] = std::max(maxX[m], px[m]);
+	  minY[m] = std::min(minY[m], py[m]);
+	  maxY[m] = std::max(maxY[m], py[m]);
+	}
+      }
+      std::int64_t block = 0;
+      for (std::size_t m = 0; m < n; ++m)
+	block += Metric::length(maxX[m] - minX[m], maxY[m] - minY[m]);
+      sum += block;
+      if (weighted)
+	for (std::size_t m = 0; m < n; ++m)
+	  wsum += w[drv[m]]
+	    * Metric::length(maxX[m] - minX[m], maxY[m] - minY[m]);
+    }
+  }
+  std::size_t big = bigStart.size() - 1;
+  for (std::size_t i = big * part / parts;
+       i < big * (part + 1) / parts; ++i) {
+    int mnX = x[bigPins[bigStart[i]]], mxX = mnX;
+    int mnY = y[bigPins[bigStart[i]]], mxY = mnY;
+    for (std::size_t k = bigStart[i] + 1; k < bigStart[i+1]; ++k) {
+      mnX = std::min(mnX, x[bigPins[k]]);
+      mxX = std::max(mxX, x[bigPins[k]]);
+      mnY = std::min(mnY, y[bigPins[k]]);
+      mxY = std::max(mxY, y[bigPins[k]]);
+    }
+    sum += Metric::length(mxX - mnX, mxY - mnY);
+    if (weighted)
+      wsum += w[bigPins[bigStart[i]]] * Metric::length(mxX - mnX, mxY - mnY);
+  }
+  return sum;
+}
+
+// total length under Metric, for linearMetric the same value as
+// layoutHPWL(). the weighted total goes to weighted
+template <class Metric>
+double hpwlEngine::compute(double *weighted)
+{
+  std::int64_t sum = 0, wsum = 0;
+  std::size_t nets = bigStart.size() - 1;
+  for (const auto& g : groups)
+    nets += g.count;
+  if (threads == 1 || nets < HPWL_MIN_PARALLEL) {
+    sum = reduce<Metric>(0, 1, wsum);
+  } else {
+    if (workers.empty()) {
+      partial.assign(threads, 0);
+      wpartial.assign(threads, 0);
+      for (unsigned t = 1; t < threads; ++t)
+	workers.push_back(std::thread(&hpwlEngine::work, this, t));
+    }
+    {
+      std::lock_guard<std::mutex> guard(lock);
+      job = &hpwlEngine::reduce<Metric>;
+      pending = threads - 1;
+      ++round;
+    }
+    wake.notify_all();
+    partial[0] = reduce<Metric>(0, threads, wpartial[0]);
+    {
+      std::unique_lock<std::mutex> guard(lock);
+      done.wait(guard, [this]() {
+	  return !pending;
+	});
+    }
+    for (unsigned t = 0; t < threads; ++t) {
+      sum += partial[t];
+      wsum += wpartial[t];
+    }
+  }
+  if (weighted)
+    *weighted = this->weighted
+      ? wsum / (double(Metric::scale) * HPWL_WEIGHT_ONE)
+      : sum / double(Metric::scale);
+  return sum / double(Metric::scale);
+}
+
+template double hpwlEngine::compute<linearMetric>(double *weighted);
+template double hpwlEngine::compute<quadraticMetric>(double *weighted);
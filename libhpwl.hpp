@@ -0,0 +1,100 @@
+#ifndef LIBHPWL_HPP
+#define LIBHPWL_HPP
+
+#include <vector>
+#include <cstdint>
+#include <unordered_map>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+
+#include "libckt.hpp"
+#include "librow.hpp"
+
+// nets up to this degree are reduced across nets with SIMD
+#define HPWL_MAX_GROUP 16
+// nets handled at once, the block stays in L1
+#define HPWL_BLOCK 256
+// below this number of nets threads cost more than they save
+#define HPWL_MIN_PARALLEL 16384
+// net weights are fixed point with this unit, the weighted sum stays
+// exact too
+#define HPWL_WEIGHT_ONE 256
+
+// length of a net from its doubled width and height, in units of
+// 1 / scale. the engine keeps Y in half sites, node::dRowHeight a row
+struct linearMetric {
+  static const int scale = 2;
+  static std::int64_t length(int dx, int dy) {
+    return dx + dy;
+  }
+};
+
+// squared width plus squared height
+struct quadraticMetric {
+  static const int scale = 4;
+  static std::int64_t length(int dx, int dy) {
+    return std::int64_t(dx) * dx + std::int64_t(dy) * dy;
+  }
+};
+
+// full layout HPWL over flat arrays
+// nets of the same degree are stored transposed, pin j of every net
+// next to each other, so min/max run over consecutive nets and the
+// compiler vectorizes them. lengths are summed as integers in half
+// units, so the result is exact and does not depend on the threads.
+// the coordinates are copied once and then follow the moved cells of
+// the journal, the threads are started once and woken for each call
+class hpwlEngine {
+private:
+  struct group {
+    int degree;
+    std::size_t count;
+    // pins[j * count + m] is the cell of pin j of net m
+    std::vector<int> pins;
+  };
+  std::vector<node*> cells;
+  std::unordered_map<node*, int> index;
+  // doubled x and y in half sites
+  std::vector<int> dX, Y;
+  // weight of the net driven by each cell, pin 0 of a net is its driver
+  std::vector<int> weight;
+  bool weighted = false;
+  std::vector<group> groups;
+  // nets above HPWL_MAX_GROUP pins
+  std::vector<std::size_t> bigStart;
+  std::vector<int> bigPins;
+  // cells copied by the last update(), for revert()
+  std::vector<int> touched;
+  unsigned threads;
+  // workers of parts 1 to threads-1, part 0 runs on the caller
+  std::vector<std::thread> workers;
+  std::mutex lock;
+  std::condition_variable wake, done;
+  std::int64_t (hpwlEngine::*job)(unsigned, unsigned,
+				  std::int64_t&) const = nullptr;
+  std::vector<std::int64_t> partial, wpartial;
+  unsigned long round = 0;
+  unsigned pending = 0;
+  bool stopping = false;
+  void work(unsigned part);
+  template <class Metric>
+  std::int64_t reduce(unsigned part, unsigned parts,
+		      std::int64_t& wsum) const;
+public:
+  hpwlEngine(const std::vector<row*>& rows, unsigned nthreads = 1);
+  ~hpwlEngine();
+  hpwlEngine(const hpwlEngine&) = delete;
+  hpwlEngine& operator=(const hpwlEngine&) = delete;
+  void gather();
+  void update(const journal& jn);
+  void revert();
+  void setWeight(node *cell, double w);
+  template <class Metric>
+  double compute(double *weighted = nullptr);
+  double compute(double *weightedHPWL = nullptr) {
+    return compute<linearMetric>(weightedHPWL);
+  }
+};
+
+#endif
@@ -0,0 +1,232 @@
+#include <iostream>
+#include <sstream>
+#include <vector>
+#include <random>
+#include <thread>
+#include <memory>
+#include <algorithm>
+#include <unordered_map>
+#include <cmath>
+#include <chrono>
+
+#include "libckt.hpp"
+#include "librow.hpp"
+#include "util.hpp"
+#include "libtiming.hpp"
+#include "libcongestion.hpp"
+#include "libmulti.hpp"
+
+extern std::random_device rd;
+extern thread_local std::mt19937 gen;
+
+namespace {
+
+// an independent copy of the circuit with its own placement
+struct chain {
+  std::vector<node*> nodes; // same order as the master nodes
+  std::unordered_map<node*, std::size_t> index;
+  std::vector<row*> rows;
+  std::unique_ptr<timer> timing;
+  std::unique_ptr<rudyMap> congestion;
+  std::mt19937 rng;
+  double k = 0.0;
+  double HPWL = 0.0;
+  // step.csv lines of this chain and of the chains it was cloned from
+  std::ostringstream steps;
+};
+
+// rows of to become the rows of from, cells matched by their index
+void copyPlacement(const std::vector<row*>& from,
+		   const std::unordered_map<node*, std::size_t>& index,
+		   std::vector<row*>& to, const std::vector<node*>& nodes)
+{
+  destroy(to);
+  for (auto r : from) {
+    row *fresh = new row(*r); // limit, origin and gaps
+    std::vector<node*> cells(r->getCells());
+    for (auto& i : cells)
+      i = nodes[index.at(i)];
+    fresh->setCells(cells);
+    to.push_back(fresh);
+  }
+  setCoordinate(to);
+}
+
+void copyChain(chain& ch, const std::vector<node*>& nodes)
+{
+  std::unordered_map<node*, node*> to;
+  for (auto i : nodes) {
+    node *fresh = new node(*i);
+    to[i] = fresh;
+    ch.index[fresh] = ch.nodes.size();
+    ch.nodes.push_back(fresh);
+  }
+  // cells outside nodes (fixed terminals) are shared, they never move
+  for (auto i : ch.nodes)
+    i->remapEdges([&to](node *old) {
+	auto search = to.find(old);
+	return search == to.end() ? old : search->second;
+      });
+}
+
+} // namespace
+
+void planChains(schedule& sch, double moveRate, int starts)
+{
+  unsigned cores = std::max(1u, std::thread::hardware_concurrency());
+  // chains beyond the cores take turns and run that much slower
+  double turns = double(starts) / std::min<unsigned>(starts, cores);
+  long long total = sch.moveBudget;
+  if (total > 0)
+    sch.moveBudget = std::max(1LL, total / starts);
+  planSchedule(sch, moveRate / turns);
+  sch.moveBudget = total;
+}
+
+// anneal starts chains in parallel, each with its own copy of the
+// circuit and generator. at every checkpoint the worst MULTI_PRUNE of
+// the chains take over the placement of a leader and go on with a new
+// seed, so later parts of the schedule are spent on the good starts.
+// the winner is copied back into rows, returns its HPWL
+double multiStart(std::vector<node*>& nodes, std::vector<row*>& rows,
+		  double k, const schedule& sch, int starts,
+		  bool randomStart, std::ostream& outFile)
+{
+  typedef std::chrono::steady_clock Time;
+  // the time budget also covers copying and starting the chains
+  auto deadline = Time::now()
+    + std::chrono::duration_cast<Time::duration>(
+	std::chrono::duration<double>(sch.timeBudget));
+  std::unordered_map<node*, std::size_t> index;
+  for (std::size_t i = 0; i < nodes.size(); ++i)
+    index[nodes[i]] = i;
+  double initHPWL = layoutHPWL(rows);
+  std::vector<std::unique_ptr<chain> > chains;
+  for (int i = 0; i < starts; ++i) {
+    chains.emplace_back(new chain);
+    chain& ch = *chains.back();
+    copyChain(ch, nodes);
+    copyPlacement(rows, index, ch.rows, ch.nodes);
+    ch.rng.seed(rd());
+    ch.k = k;
+    ch.HPWL = initHPWL;
+  }
+  // costs that keep state need their own per chain
+  auto prepare = [&sch](chain& ch) {
+    if (sch.timing)
+      ch.timing.reset(new timer(ch.nodes));
+    if (sch.congestion)
+      ch.congestion.reset(new rudyMap(ch.rows));
+  };
+  prepare(*chains.front());
+  bool verbose = enableVerbose;
+  enableVerbose = false; // chains would interleave their messages
+  // the first chain keeps the given placement, the others start over
+  std::vector<std::thread> pool;
+  for (int i = 1; i < starts; ++i)
+    pool.push_back(std::thread([&, i]() {
+	  chain& ch = *chains[i];
+	  gen = ch.rng;
+	  if (randomStart) {
+	    initialPlacement(ch.nodes, ch.rows);
+	    setCoordinate(ch.rows);
+	    ch.HPWL = layoutHPWL(ch.rows);
+	  }
+	  prepare(ch);
+	  if (randomStart) {
+	    schedule own = sch;
+	    own.timing = ch.timing.get();
+	    own.congestion = ch.congestion.get();
+	    ch.k = kboltz(ch.rows, own);
+	  }
+	  ch.rng = gen;
+	}));
+  for (auto& t : pool)
+    t.join();
+  // the first part takes MULTI_WARM of the temperature steps, the
+  // checkpoints split the cooler rest evenly
+  int steps = std::max(1, int(std::ceil(std::log(sch.frzTemp / sch.maxTemp)
+					/ std::log(sch.coolRate))));
+  std::vector<int> bounds(1, 0);
+  int warm = std::min(steps, std::max(1, int(steps * MULTI_WARM)));
+  bounds.push_back(warm);
+  int part = (steps - warm + MULTI_CHECKPOINTS - 2) / (MULTI_CHECKPOINTS - 1);
+  for (int s = warm + part; part && s < steps; s += part)
+    bounds.push_back(s);
+  if (bounds.back() < steps)
+    bounds.push_back(steps);
+  int parts = bounds.size() - 1;
+  for (int c = 0; c < parts; ++c) {
+    schedule round = sch;
+    round.maxTemp = sch.maxTemp * std::pow(sch.coolRate, bounds[c]);
+    bool last = c + 1 == parts;
+    // half a step above the first temperature of the next part
+    if (!last)
+      round.frzTemp = sch.maxTemp
+	* std::pow(sch.coolRate, bounds[c+1] - 0.5);
+    // the budgets are shared out by temperature steps, the time left
+    // so a part that ran over is taken from the later ones. every
+    // chain gets its part of the moves
+    double share = double(bounds[c+1] - bounds[c]) / (steps - bounds[c]);
+    if (sch.moveBudget > 0)
+      round.moveBudget = std::max(1LL, sch.moveBudget
+				  * (bounds[c+1] - bounds[c]) / steps / starts);
+    if (sch.timeBudget > 0) {
+      std::chrono::duration<double> left = deadline - Time::now();
+      if (left.count() <= 0)
+	break; // the chains keep where they are
+      round.timeBudget = left.count() * share;
+    }
+    round.threads = 1; // the chains are the threads
+    round.progress = nullptr;
+    pool.clear();
+    for (auto& i : chains)
+      pool.push_back(std::thread([&round](chain *ch) {
+	    schedule own = round;
+	    own.timing = ch->timing.get();
+	    own.congestion = ch->congestion.get();
+	    gen = ch->rng;
+	    ch->HPWL = annealing(ch->rows, ch->k, ch->HPWL, own, ch->steps);
+	    ch->rng = gen;
+	  }, i.get()));
+    for (auto& t : pool)
+      t.join();
+    std::vector<chain*> order;
+    for (auto& i : chains)
+      order.push_back(i.get());
+    std::stable_sort(order.begin(), order.end(), [](chain *a, chain *b) {
+	return a->HPWL < b->HPWL;
+      });
+    if (last)
+      break;
+    double worst = order.back()->HPWL;
+    int kill = std::min<int>(starts - 1, starts * MULTI_PRUNE);
+    for (int j = 0; j < kill; ++j) {
+      chain *loser = order[starts - 1 - j];
+      chain *leader = order[j % (starts - kill)];
+      copyPlacement(leader->rows, leader->index, loser->rows, loser->nodes);
+      loser->k = leader->k;
+      loser->HPWL = leader->HPWL;
+      loser->steps.str(leader->steps.str());
+      loser->steps.seekp(0, std::ios_base::end);
+      loser->rng.seed(rd());
+    }
+    if (verbose)
+      std::cout << "Checkpoint " << c + 1 << ": best HPWL "
+		<< order.front()->HPWL << ", worst " << worst
+		<< ", " << kill << " chains cloned" << std::endl;
+  }
+  enableVerbose = verbose;
+  chain *best = chains.front().get();
+  for (auto& i : chains)
+    if (i->HPWL < best->HPWL)
+      best = i.get();
+  copyPlacement(best->rows, best->index, rows, nodes);
+  outFile << best->steps.str();
+  for (auto& i : chains) {
+    destroy(i->rows);
+    for (auto j : i->nodes)
+      delete j;
+  }
+  return best->HPWL;
+}
@@ -0,0 +1,29 @@
+#ifndef LIBMULTI_HPP
+#define LIBMULTI_HPP
+
+#include <iostream>
+#include <vector>
+
+#include "libckt.hpp"
+#include "librow.hpp"
+#include "util.hpp"
+
+// the schedule is run in this many parts, the chains are compared
+// after each part but the last
+#define MULTI_CHECKPOINTS 4
+// fraction of the temperature steps in the first part. the chains are
+// still close to a random walk before, and comparing them then only
+// prunes on noise
+#define MULTI_WARM 0.6
+// fraction of the chains replaced by clones of the leaders each time
+#define MULTI_PRUNE 0.5
+
+// fit the schedule of every chain into the budgets of sch, from the
+// rate of one chain on its own core. moveBudget is the total of the
+// chains
+void planChains(schedule& sch, double moveRate, int starts);
+double multiStart(std::vector<node*>& nodes, std::vector<row*>& rows,
+		  double k, const schedule& sch, int starts,
+		  bool randomStart, std::ostream& outFile);
+
+#endif
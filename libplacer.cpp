@@ -0,0 +1,191 @@
+#include <vector>
+#include <random>
+#include <ostream>
+#include <thread>
+#include <chrono>
+#include <exception>
+
+#include "libckt.hpp"
+#include "librow.hpp"
+#include "util.hpp"
+#include "libdetail.hpp"
+#include "placer.h"
+
+extern std::random_device rd;
+extern thread_local std::mt19937 gen;
+
+struct placer {
+  std::vector<node*> nodes;
+  std::vector<row*> rows;
+  double HPWL = 0.0;
+};
+
+namespace {
+
+// the gate counts and the area are global, take the cells out of them
+void clearNodes(placer *p)
+{
+  destroy(p->rows);
+  for (auto i : p->nodes) {
+    --node::count[i->getType()];
+    node::doublearea -= i->getDoubleWidth();
+    delete i;
+  }
+  p->nodes.clear();
+  p->HPWL = 0.0;
+}
+
+} // namespace
+
+extern "C" {
+
+void placer_default_params(placer_params *params)
+{
+  schedule sch;
+  params->max_temp = sch.maxTemp;
+  params->frz_temp = sch.frzTemp;
+  params->cool_rate = sch.coolRate;
+  params->moves_per_temp = 0;
+  params->move_budget = 0;
+  params->time_budget = 0.0;
+  params->detail_window = 0;
+  params->threads = 1;
+  params->seed = 0;
+}
+
+placer *placer_create(void)
+{
+  enableVerbose = false;
+  try {
+    return new placer;
+  } catch (const std::exception& e) {
+    return nullptr;
+  }
+}
+
+void placer_destroy(placer *p)
+{
+  if (!p)
+    return;
+  clearNodes(p);
+  delete p;
+}
+
+int placer_load(placer *p, int num_cells, const int *types,
+		const int *fanin_start, const int *fanin)
+{
+  if (!p)
+    return PLACER_ERROR;
+  // a failed load leaves no netlist behind
+  clearNodes(p);
+  if (num_cells <= 0 || !types || !fanin_start || fanin_start[0] < 0)
+    return PLACER_ERROR;
+  for (int i = 0; i < num_cells; ++i) {
+    if (types[i] < PLACER_NAND || types[i] > PLACER_OUTP
+	|| fanin_start[i+1] < fanin_start[i])
+      return PLACER_ERROR;
+  }
+  if (fanin_start[num_cells] > fanin_start[0] && !fanin)
+    return PLACER_ERROR;
+  for (int j = fanin_start[0]; j < fanin_start[num_cells]; ++j) {
+    if (fanin[j] < 0 || fanin[j] >= num_cells)
+      return PLACER_ERROR;
+  }
+  try {
+    p->nodes.reserve(num_cells);
+    for (int i = 0; i < num_cells; ++i)
+      p->nodes.push_back(new node(std::string(), GateType(types[i])));
+    for (int i = 0; i < num_cells; ++i) {
+      for (int j = fanin_start[i]; j < fanin_start[i+1]; ++j) {
+	p->nodes[i]->pushFanin(p->nodes[fanin[j]]);
+	p->nodes[fanin[j]]->pushFanout(p->nodes[i]);
+      }
+      p->nodes[i]->setWidth();
+    }
+  } catch (const std::exception& e) {
+    clearNodes(p);
+    return PLACER_ERROR;
+  }
+  return PLACER_OK;
+}
+
+// same flow as place in placement.cpp without the files
+int placer_run(placer *p, const placer_params *params,
+	       placer_progress progress, void *user)
+{
+  if (!p || !params || p->nodes.empty())
+    return PLACER_ERROR;
+  // a schedule that never reaches frz_temp would not return
+  if (!(params->cool_rate > 0 && params->cool_rate < 1)
+      || !(params->frz_temp > 0 && params->frz_temp < params->max_temp))
+    return PLACER_ERROR;
+  typedef std::chrono::steady_clock Time;
+  auto start = Time::now();
+  try {
+    gen.seed(params->seed ? params->seed : rd());
+    initialPlacement(p->nodes, p->rows);
+    setCoordinate(p->rows);
+    double initHPWL = layoutHPWL(p->rows);
+    schedule sch;
+    sch.maxTemp = params->max_temp;
+    sch.frzTemp = params->frz_temp;
+    sch.coolRate = params->cool_rate;
+    sch.num_moves = params->moves_per_temp > 0 ? params->moves_per_temp
+      : p->nodes.size();
+    sch.moveBudget = params->move_budget;
+    sch.threads = std::max(1u, params->threads);
+    double k = kboltz(p->rows, sch);
+    if (params->time_budget > 0 || params->move_budget > 0) {
+      double rate = measurePolicyRate(p->rows, 50, sch);
+      if (params->time_budget > 0) {
+	std::chrono::duration<double> elapsed = Time::now() - start;
+	sch.timeBudget = std::max(params->time_budget - elapsed.count(),
+				  1e-3);
+	if (params->detail_window)
+	  sch.timeBudget *= 1.0 - DETAIL_TIME_SHARE;
+      }
+      planSchedule(sch, rate);
+    }
+    if (progress)
+      sch.progress = [progress, user](double T, double HPWL) {
+	return progress(T, HPWL, user) != 0;
+      };
+    std::ostream steps(nullptr); // no step.csv
+    p->HPWL = annealing(p->rows, k, initHPWL, sch, steps);
+    if (params->detail_window) {
+      double detailBudget = 0.0;
+      if (params->time_budget > 0) {
+	std::chrono::duration<double> elapsed = Time::now() - start;
+	detailBudget = std::max(params->time_budget - elapsed.count(), 1e-3);
+      }
+      p->HPWL = detailedPlacement(p->rows, p->nodes, params->detail_window,
+				  std::max(1u, params->threads), detailBudget);
+    }
+  } catch (const std::exception& e) {
+    return PLACER_ERROR;
+  }
+  return PLACER_OK;
+}
+
+int placer_num_cells(const placer *p)
+{
+  return p ? p->nodes.size() : 0;
+}
+
+double placer_hpwl(const placer *p)
+{
+  return p ? p->HPWL : 0.0;
+}
+
+int placer_get_coordinates(const placer *p, double *x, int *y)
+{
+  if (!p || !x || !y || p->rows.empty())
+    return PLACER_ERROR;
+  for (std::size_t i = 0; i < p->nodes.size(); ++i) {
+    x[i] = p->nodes[i]->getDoubleX() / 2.0;
+    y[i] = p->nodes[i]->getY();
+  }
+  return PLACER_OK;
+}
+
+} // extern "C"
@@ -0,0 +1,87 @@
+#include <iostream>
+#include <string>
+#include <vector>
+#include <thread>
+#include <algorithm>
+#include <functional>
+#include <cmath>
+#include <cstdio>
+
+#include "libreport.hpp"
+
+void appendInt(std::string& out, long long num)
+{
+  char digits[24];
+  char *p = digits + sizeof(digits);
+  unsigned long long mag = num < 0 ? 0ull - num : num;
+  do {
+    *--p = '0' + mag % 10;
+    mag /= 10;
+  } while (mag);
+  if (num < 0)
+    *--p = '-';
+  out.append(p, digits + sizeof(digits) - p);
+}
+
+// the default ostream format is %g with 6 significant digits, an
+// integer below 1e6 or a half below 1e5 prints exactly as written
+void appendHalf(std::string& out, long long dnum)
+{
+  if (dnum <= -200000 || dnum >= 200000) {
+    appendDouble(out, dnum / 2.0);
+    return;
+  }
+  if (dnum < 0) {
+    out += '-';
+    dnum = -dnum;
+  }
+  appendInt(out, dnum / 2);
+  if (dnum % 2)
+    out += ".5";
+}
+
+void appendDouble(std::string& out, double num)
+{
+  // -0.0 keeps its sign
+  if (num != 0.0 || !std::signbit(num)) {
+    if (num > -1e5 && num < 1e5 && num == std::floor(2.0 * num) / 2.0) {
+      appendHalf(out, (long long)(2.0 * num));
+      return;
+    }
+    if (num > -1e6 && num < 1e6 && num == std::floor(num)) {
+      appendInt(out, (long long)num);
+      return;
+    }
+  }
+  char text[32];
+  int len = std::snprintf(text, sizeof(text), "%g", num);
+  out.append(text, len);
+}
+
+void writeSection(std::ostream& outFile, std::size_t lines,
+		  const std::function<void(std::string&, std::size_t,
+					   std::size_t)>& format)
+{
+  std::size_t chunks = (lines + REPORT_CHUNK - 1) / REPORT_CHUNK;
+  unsigned threads = 1;
+  if (lines >= REPORT_MIN_PARALLEL)
+    threads = std::max(1u, std::thread::hardware_concurrency());
+  threads = std::min<std::size_t>(threads, std::max<std::size_t>(1, chunks));
+  std::vector<std::string> buffers(threads);
+  for (std::size_t first = 0; first < chunks; first += threads) {
+    unsigned round = std::min<std::size_t>(threads, chunks - first);
+    auto work = [&](unsigned t) {
+      std::size_t begin = (first + t) * REPORT_CHUNK;
+      buffers[t].clear();
+      format(buffers[t], begin, std::min(lines, begin + REPORT_CHUNK));
+    };
+    std::vector<std::thread> pool;
+    for (unsigned t = 1; t < round; ++t)
+      pool.push_back(std::thread(work, t));
+    work(0);
+    for (auto& t : pool)
+      t.join();
+    for (unsigned t = 0; t < round; ++t)
+      outFile.write(buffers[t].data(), buffers[t].size());
+  }
+}
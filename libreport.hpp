@@ -0,0 +1,26 @@
+#ifndef LIBREPORT_HPP
+#define LIBREPORT_HPP
+
+#include <iostream>
+#include <string>
+#include <functional>
+
+// lines formatted into one buffer and written at once
+#define REPORT_CHUNK 16384
+// below this many lines threads cost more than they save
+#define REPORT_MIN_PARALLEL 65536
+
+// numbers printed the way an ostream with default flags prints them
+void appendInt(std::string& out, long long num);
+// dnum / 2.0, for the doubled widths and coordinates
+void appendHalf(std::string& out, long long dnum);
+void appendDouble(std::string& out, double num);
+
+// format(out, begin, end) appends lines [begin, end) of a section.
+// chunks of REPORT_CHUNK lines are formatted in parallel and written
+// in order, the buffers are reused from one round of chunks to the next
+void writeSection(std::ostream& outFile, std::size_t lines,
+		  const std::function<void(std::string&, std::size_t,
+					   std::size_t)>& format);
+
+#endif
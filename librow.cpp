@@ -1,12 +1,13 @@
 #include <vector>
 #include <random>
 #include <iterator>
+#include <algorithm>
 
 #include "libckt.hpp"
 #include "librow.hpp"
 #include "util.hpp"
 
-extern std::mt19937 gen;
+extern thread_local std::mt19937 gen;
 
 bool row::push_back(node *new_node) {
   int new_dWidth = new_node->getDoubleWidth();
@@ -20,6 +21,24 @@ bool row::push_back(node *new_node) {
   }
 }
 
+// insert a node before idx, keeping the order of the row
+bool row::insert(std::size_t idx, node *new_node) {
+  int new_dWidth = new_node->getDoubleWidth();
+  if (dWidthSum + new_dWidth > dWidthLimit)
+    return false;
+  dWidthSum += new_dWidth;
+  row_vector.insert(row_vector.begin() + idx, new_node);
+  return true;
+}
+
+// remove the node at idx, keeping the order of the row
+node *row::erase(std::size_t idx) {
+  node *ans = row_vector[idx];
+  dWidthSum -= ans->getDoubleWidth();
+  row_vector.erase(row_vector.begin() + idx);
+  return ans;
+}
+
 // random insert a node
 bool row::random_insert(node *new_node) {
   int new_dWidth = new_node->getDoubleWidth();
@@ -54,37 +73,87 @@ void row::setElement(std::size_t idx, node *new_node) {
   row_vector[idx] = new_node;
 }
 
+// the row is dWidthLimit wide from dOrigin, blocked keeps its cells
+// out of some ranges. a cell that does not fit before a gap leaves
+// less than its width behind, so the limit also drops by the widest
+// cell per gap and any order of cells within it stays in the row
+void row::setGaps(const std::vector<std::pair<int, int> >& blocked,
+		  int dmaxWidth) {
+  dEnd = dOrigin + dWidthLimit;
+  gaps.clear();
+  for (auto i : blocked) {
+    i.first = std::max(i.first, dOrigin);
+    i.second = std::min(i.second, dEnd);
+    if (i.first >= i.second)
+      continue;
+    if (!gaps.empty() && i.first <= gaps.back().second)
+      gaps.back().second = std::max(gaps.back().second, i.second);
+    else
+      gaps.push_back(i);
+  }
+  for (const auto& i : gaps)
+    dWidthLimit -= i.second - i.first + dmaxWidth;
+  dWidthLimit = std::max(0, dWidthLimit);
+}
+
 // set coordinate for current row
 void row::setCoordinate(int Y) {
   int current_dWidth = 0;
+  int x = dOrigin;
+  std::size_t g = 0;
   for (auto i: row_vector) {
-    i->setDoubleX(current_dWidth);
+    x = skip(x, i->getDoubleWidth(), g);
+    i->setDoubleX(x);
     i->setY(Y);
+    x += i->getDoubleWidth();
     current_dWidth += i->getDoubleWidth();
   }
   // after all set, set the total width of the row
   dWidthSum = current_dWidth;
 }
 
-// calculate HPWL of current row
-double row::calHPWL() {
-  double result = 0.0;
-  for (auto i: row_vector) 
-    result += i->netHPWLCal();
-  return result;
+// replace the whole content of the row
+void row::setCells(const std::vector<node*>& cells) {
+  row_vector = cells;
+  dWidthSum = 0;
+  for (auto i: row_vector)
+    dWidthSum += i->getDoubleWidth();
 }
 
-// update coordinate
-void row::updateCoordinate() {
-  int current_dWidth = 0;
-  for (auto i: row_vector) {
-    if (current_dWidth != i->getDoubleWidth()) {
+// set coordinate starting at first, the cells after last are
+// only visited until they are found at the right place again
+void row::updateCoordinate(std::size_t first, std::size_t last, int Y,
+			   journal& jn) {
+  int current_dWidth = dOrigin;
+  if (first) {
+    node *prev = row_vector[first-1];
+    current_dWidth = prev->getDoubleX() + prev->getDoubleWidth();
+  }
+  std::size_t g = 0;
+  while (g < gaps.size() && gaps[g].second <= current_dWidth)
+    ++g;
+  for (auto j = first; j < row_vector.size(); ++j) {
+    node *i = row_vector[j];
+    current_dWidth = skip(current_dWidth, i->getDoubleWidth(), g);
+    if (i->getDoubleX() != current_dWidth || i->getY() != Y) {
+      jn.recordCoord(i);
       i->setDoubleX(current_dWidth);
+      i->setY(Y);
+    } else if (j > last) {
+      break;
     }
     current_dWidth += i->getDoubleWidth();
   }
 }
 
+// calculate HPWL of current row
+double row::calHPWL() {
+  double result = 0.0;
+  for (auto i: row_vector) 
+    result += i->netHPWLCal();
+  return result;
+}
+
 // random pop an element
 node *row::random_pop() {
   if (row_vector.empty())
@@ -93,3 +162,53 @@ node *row::random_pop() {
   return remove_at(row_vector, idx);
 }
 
+
+// undo the recorded changes in reverse order
+void journal::rollback(std::vector<row*>& rows) {
+  for (auto i = slots.rbegin(); i != slots.rend(); ++i)
+    rows[i->row_idx]->setElement(i->idx, i->cell);
+  for (auto i = coords.rbegin(); i != coords.rend(); ++i) {
+    i->cell->setDoubleX(i->dX);
+    i->cell->setY(i->Y);
+  }
+  clear();
+}
+
+void snapshot::take(const std::vector<row*>& rows) {
+  cells.resize(rows.size());
+  limit = 0;
+  for (std::size_t i = 0; i < rows.size(); ++i) {
+    cells[i] = rows[i]->getCells();
+    limit += cells[i].size();
+  }
+  pending.clear();
+  stale = false;
+}
+
+// remember which slots an accepted move touched
+void snapshot::record(const journal& jn) {
+  if (stale)
+    return;
+  for (std::size_t i = 0; i < jn.slotCount(); ++i)
+    pending.push_back(std::make_pair(jn.slotRow(i), jn.slotIdx(i)));
+  if (pending.size() > limit) { // cheaper to copy everything
+    pending.clear();
+    stale = true;
+  }
+}
+
+// current placement becomes the snapshot
+void snapshot::commit(const std::vector<row*>& rows) {
+  if (stale) {
+    take(rows);
+    return;
+  }
+  for (auto& i: pending)
+    cells[i.first][i.second] = rows[i.first]->getCells()[i.second];
+  pending.clear();
+}
+
+void snapshot::restore(std::vector<row*>& rows) const {
+  for (std::size_t i = 0; i < rows.size(); ++i)
+    rows[i]->setCells(cells[i]);
+}
@@ -2,22 +2,63 @@
 #define LIBROW_HPP
 
 #include <vector>
+#include <utility>
 
 #include "libckt.hpp"
 
+class journal;
+
 class row {
 private:
   std::vector<node*> row_vector;
   int dWidthLimit;
   int dWidthSum = 0;
+  // double of the x index of the first site
+  int dOrigin = 0;
+  // doubled x ranges [first, second) that take no cells, sorted
+  std::vector<std::pair<int, int> > gaps;
+  int dEnd = 0;
+  // x of a cell of dwidth at x or past the gaps in its way, from gap g
+  int skip(int x, int dwidth, std::size_t& g) const {
+    while (g < gaps.size() && gaps[g].first < x + dwidth) {
+      if (gaps[g].second > x)
+	x = gaps[g].second;
+      ++g;
+    }
+    return x;
+  }
 public:
   row(int dlimit) {
     dWidthLimit = dlimit;
   }
+  row(int dlimit, int dorigin) {
+    dWidthLimit = dlimit;
+    dOrigin = dorigin;
+  }
   ~row() {
     row_vector.clear();
   }
   bool push_back(node *new_node);
+  bool insert(std::size_t idx, node *new_node);
+  node *erase(std::size_t idx);
+  int getLimit() const {
+    return dWidthLimit;
+  }
+  int getOrigin() const {
+    return dOrigin;
+  }
+  // end of the row, the cells may reach past it only when a move
+  // overfilled the row
+  int getEnd() const {
+    return gaps.empty() ? dOrigin + dWidthLimit : dEnd;
+  }
+  void setGaps(const std::vector<std::pair<int, int> >& blocked,
+	       int dmaxWidth);
+  // x of a cell of dwidth at x, moved past the gaps in its way
+  int place(int x, int dwidth) const {
+    std::size_t g = 0;
+    return skip(x, dwidth, g);
+  }
   node* operator[](std::size_t idx) {
     return row_vector[idx];
   }
@@ -29,12 +70,83 @@ public:
   std::size_t size() {
     return row_vector.size();
   }
+  const std::vector<node*>& getCells() const {
+    return row_vector;
+  }
+  void setCells(const std::vector<node*>& cells);
   void setCoordinate(int Y);
   double calHPWL();
-  void updateCoordinate();
+  void updateCoordinate(std::size_t first, std::size_t last, int Y,
+			journal& jn);
   node *random_pop();
   bool random_insert(node *new_node);
 };
 
+// records the fields changed by a move so it can be undone
+// in O(changed cells) instead of being swapped back
+class journal {
+private:
+  struct slot {
+    std::size_t row_idx;
+    std::size_t idx;
+    node *cell;
+  };
+  struct coord {
+    node *cell;
+    int dX;
+    int Y;
+  };
+  std::vector<slot> slots;
+  std::vector<coord> coords;
+public:
+  void recordSlot(std::size_t row_idx, std::size_t idx, node *cell) {
+    slots.push_back({row_idx, idx, cell});
+  }
+  void recordCoord(node *cell) {
+    coords.push_back({cell, cell->getDoubleX(), cell->getY()});
+  }
+  std::size_t coordCount() const {
+    return coords.size();
+  }
+  node *coordCell(std::size_t i) const {
+    return coords[i].cell;
+  }
+  // coordinates of the cell before the move
+  int coordDoubleX(std::size_t i) const {
+    return coords[i].dX;
+  }
+  int coordY(std::size_t i) const {
+    return coords[i].Y;
+  }
+  std::size_t slotCount() const {
+    return slots.size();
+  }
+  std::size_t slotRow(std::size_t i) const {
+    return slots[i].row_idx;
+  }
+  std::size_t slotIdx(std::size_t i) const {
+    return slots[i].idx;
+  }
+  void clear() {
+    slots.clear();
+    coords.clear();
+  }
+  void rollback(std::vector<row*>& rows);
+};
+
+// copy of the best placement seen so far, kept up to date by
+// replaying the slots changed since the last copy
+class snapshot {
+private:
+  std::vector<std::vector<node*>> cells;
+  std::vector<std::pair<std::size_t, std::size_t>> pending;
+  std::size_t limit = 0;
+  bool stale = false;
+public:
+  void take(const std::vector<row*>& rows);
+  void record(const journal& jn);
+  void commit(const std::vector<row*>& rows);
+  void restore(std::vector<row*>& rows) const;
+};
 
 #endif
@@ -0,0 +1,228 @@
+#include <vector>
+#include <queue>
+#include <functional>
+#include <unordered_map>
+#include <algorithm>
+
+#include "libckt.hpp"
+#include "libtiming.hpp"
+
+// intrinsic delay, roughly following the widths of assignDoubleWidth()
+double gateDelay(GateType Type)
+{
+  switch (Type) {
+  case INP: /* fall-thru */
+  case OUTP:
+    return 0.0;
+  case INV:
+    return 1.0;
+  case BUF: /* fall-thru */
+  case NAND:
+    return 1.5;
+  case NOR: /* fall-thru */
+  case AND:
+    return 2.0;
+  case OR:
+    return 2.5;
+  case XOR: /* fall-thru */
+  case XNOR:
+    return 3.5;
+  default: // cells of a Bookshelf design have no function
+    return 1.0;
+  }
+}
+
+timer::timer(const std::vector<node*>& nodes)
+  : cells(nodes)
+{
+  std::size_t n = cells.size();
+  for (std::size_t i = 0; i < n; ++i)
+    index[cells[i]] = i;
+  // Kahn's algorithm over the fanin edges
+  std::vector<std::vector<int> > pred(n);
+  std::vector<int> pending(n, 0);
+  for (std::size_t i = 0; i < n; ++i) {
+    for (auto j : cells[i]->getFanin()) {
+      auto search = index.find(j);
+      if (search == index.end())
+	continue;
+      pred[i].push_back(search->second);
+      ++pending[i];
+    }
+  }
+  std::vector<std::vector<int> > succ(n);
+  for (std::size_t i = 0; i < n; ++i)
+    for (auto j : pred[i])
+      succ[j].push_back(i);
+  level.assign(n, -1);
+  std::vector<int> ready;
+  for (std::size_t i = 0; i < n; ++i)
+    if (!pending[i]) {
+      level[i] = 0;
+      ready.push_back(i);
+    }
+  while (!ready.empty()) {
+    int u = ready.back();
+    ready.pop_back();
+    for (auto v : succ[u]) {
+      level[v] = std::max(level[v], level[u] + 1);
+      if (!--pending[v])
+	ready.push_back(v);
+    }
+  }
+  // cells on a cycle go after what they can see of their fanin
+  for (std::size_t i = 0; i < n; ++i) {
+    if (!pending[i])
+      continue;
+    int l = std::max(0, level[i]);
+    for (auto j : pred[i])
+      if (!pending[j])
+	l = std::max(l, level[j] + 1);
+    level[i] = l;
+    pending[i] = 0;
+  }
+  fanin.resize(n);
+  fanout.resize(n);
+  for (std::size_t i = 0; i < n; ++i) {
+    for (auto j : pred[i]) {
+      if (level[j] >= level[i])
+	continue;
+      fanin[i].push_back(j);
+      fanout[j].push_back(i);
+    }
+  }
+  delay.resize(n);
+  for (std::size_t i = 0; i < n; ++i)
+    delay[i] = gateDelay(cells[i]->getType());
+  wire.assign(n, 0.0);
+  arrival.assign(n, 0.0);
+  downstream.assign(n, 0.0);
+  queued.assign(n, 0);
+}
+
+double timer::calArrival(int v) const
+{
+  double ans = 0.0;
+  for (auto u : fanin[v])
+    ans = std::max(ans, arrival[u] + wire[u]);
+  return ans + delay[v];
+}
+
+double timer::calDownstream(int v) const
+{
+  double ans = 0.0;
+  for (auto w : fanout[v])
+    ans = std::max(ans, wire[v] + delay[w] + downstream[w]);
+  return ans;
+}
+
+// full analysis from the current coordinates
+void timer::analyse()
+{
+  std::size_t n = cells.size();
+  std::vector<int> order(n);
+  for (std::size_t i = 0; i < n; ++i)
+    order[i] = i;
+  std::stable_sort(order.begin(), order.end(), [this](int a, int b) {
+      return level[a] < level[b];
+    });
+  for (std::size_t i = 0; i < n; ++i)
+    wire[i] = WIRE_DELAY * cells[i]->netHPWLCal();
+  for (auto v : order)
+    arrival[v] = calArrival(v);
+  for (auto it = order.rbegin(); it != order.rend(); ++it)
+    downstream[*it] = calDownstream(*it);
+}
+
+// after moving cells, only the nets they are on change length. arrival
+// is pushed forward and downstream backward level by level, stopping
+// where a value does not change
+void timer::update(const std::vector<node*>& moved)
+{
+  typedef std::pair<int, int> item; // level, cell
+  std::priority_queue<item, std::vector<item>, std::greater<item> > forward;
+  std::priority_queue<item> backward;
+  std::vector<int> drivers;
+  auto driver = [&](node *cell) {
+    auto search = index.find(cell);
+    if (search != index.end() && !queued[search->second]) {
+      queued[search->second] = 1;
+      drivers.push_back(search->second);
+    }
+  };
+  for (auto i : moved) {
+    driver(i);
+    for (auto j : i->getFanin())
+      driver(j);
+  }
+  for (auto u : drivers)
+    queued[u] = 0;
+  // the two passes share the flags, backward only starts after forward
+  std::vector<int> upstream;
+  for (auto u : drivers) {
+    double w = WIRE_DELAY * cells[u]->netHPWLCal();
+    if (w == wire[u])
+      continue;
+    wire[u] = w;
+    upstream.push_back(u);
+    for (auto v : fanout[u]) {
+      if (queued[v])
+	continue;
+      queued[v] = 1;
+      forward.push(item(level[v], v));
+    }
+  }
+  while (!forward.empty()) {
+    int v = forward.top().second;
+    forward.pop();
+    queued[v] = 0;
+    double a = calArrival(v);
+    if (a == arrival[v])
+      continue;
+    arrival[v] = a;
+    for (auto w : fanout[v]) {
+      if (queued[w])
+	continue;
+      queued[w] = 1;
+      forward.push(item(level[w], w));
+    }
+  }
+  for (auto u : upstream) {
+    queued[u] = 1;
+    backward.push(item(level[u], u));
+  }
+  while (!backward.empty()) {
+    int v = backward.top().second;
+    backward.pop();
+    queued[v] = 0;
+    double d = calDownstream(v);
+    if (d == downstream[v])
+      continue;
+    downstream[v] = d;
+    for (auto u : fanin[v]) {
+      if (queued[u])
+	continue;
+      queued[u] = 1;
+      backward.push(item(level[u], u));
+    }
+  }
+}
+
+// longest path of the circuit
+double timer::criticalDelay() const
+{
+  double ans = 0.0;
+  for (std::size_t i = 0; i < cells.size(); ++i)
+    ans = std::max(ans, arrival[i] + downstream[i]);
+  return ans;
+}
+
+// longest path through the net driven by cell over the critical delay
+double timer::criticality(node *cell, double critical) const
+{
+  auto search = index.find(cell);
+  if (search == index.end() || critical <= 0.0)
+    return 0.0;
+  int i = search->second;
+  return (arrival[i] + downstream[i]) / critical;
+}
@@ -0,0 +1,46 @@
+#ifndef LIBTIMING_HPP
+#define LIBTIMING_HPP
+
+#include <vector>
+#include <unordered_map>
+
+#include "libckt.hpp"
+
+// delay of a net per unit of its HPWL
+#define WIRE_DELAY 0.1
+// net weight is 1 + TIMING_WEIGHT * criticality^CRIT_EXP
+#define TIMING_WEIGHT 4.0
+#define CRIT_EXP 2.0
+
+double gateDelay(GateType Type);
+
+// levelized static timing over the fanin/fanout DAG
+// a net adds WIRE_DELAY times its HPWL between its driver and every
+// sink. arrival is the longest path from an input to the output of a
+// cell, downstream the longest path from there to an output, so the
+// longest path through a cell is their sum and does not depend on the
+// critical delay. moving cells only re-propagates through their cones
+class timer {
+private:
+  std::vector<node*> cells;
+  std::unordered_map<node*, int> index;
+  std::vector<int> level;
+  // edges between levels only, a cycle loses its backward edges
+  std::vector<std::vector<int> > fanin, fanout;
+  std::vector<double> delay, wire, arrival, downstream;
+  // scratch of update()
+  std::vector<char> queued;
+  double calArrival(int v) const;
+  double calDownstream(int v) const;
+public:
+  timer(const std::vector<node*>& nodes);
+  void analyse();
+  void update(const std::vector<node*>& moved);
+  double criticalDelay() const;
+  double criticality(node *cell, double critical) const;
+  const std::vector<node*>& getCells() const {
+    return cells;
+  }
+};
+
+#endif
@@ -6,10 +6,21 @@
 #include <cmath>
 #include <chrono>
 #include <iterator>
+#include <thread>
+#include <memory>
 
 #include "libckt.hpp"
 #include "librow.hpp"
 #include "util.hpp"
+#include "libdetail.hpp"
+#include "libgen.hpp"
+#include "libbookshelf.hpp"
+#include "libeco.hpp"
+#include "libtiming.hpp"
+#include "libcongestion.hpp"
+#include "libmulti.hpp"
+
+#include <sys/resource.h>
 
 bool enableMultiThread = false;
 
@@ -20,10 +31,11 @@ int main(int argc, char *argv[])
   typedef std::chrono::duration<float> fsec;
   
   std::vector<node*> inputs, outputs, nodes;
-  std::map<std::string, node*> circuit; 
+  cellMap circuit; 
   std::string ckt_result = "ckt_details.txt";
   std::string annealing_step = "step.csv";
   std::vector<row*> rows;
+  bookshelf design;
   
   std::vector<std::string> args(argv, argv+argc);
 
@@ -50,43 +62,150 @@ int main(int argc, char *argv[])
     } else if (args.at(1) == "place") {
       std::string ckt_filename(args.at(2));
       std::cout << "Reading circuit file from " << ckt_filename << std::endl;
-      std::ifstream ckt_file(ckt_filename);
-      if (!ckt_file.is_open()) {
-	std::cout << "failed to open " << ckt_filename << std::endl;
-	exit(1);
+      bool use_bookshelf = isBookshelf(ckt_filename);
+      if (use_bookshelf) {
+	parseBookshelf(ckt_filename, nodes, circuit, design);
+      } else {
+	std::ifstream ckt_file(ckt_filename);
+	if (!ckt_file.is_open()) {
+	  std::cout << "failed to open " << ckt_filename << std::endl;
+	  exit(1);
+	}
+	parseCkt(ckt_file, inputs, outputs, nodes, circuit);
+	ckt_file.close();
       }
-      parseCkt(ckt_file, inputs, outputs, nodes, circuit);
-      ckt_file.close();
+      schedule sch;
+      double time_budget = 0.0;
+      int window = 0;
+      int starts = 1;
+      bool timing_cost = false, congestion_cost = false;
+      bool quadratic_cost = false;
+      bool reorder = false;
       auto begin_iter = args.begin();
-      std::advance(begin_iter, 2);
-      for (auto iter = begin_iter; iter != args.end(); ++iter) {
+      std::advance(begin_iter, 3);
+      for (auto iter = begin_iter; iter < args.end(); ++iter) {
 	if (*iter == "--thread") {
 	  enableMultiThread = true;
 	  if (enableMultiThread)
 	    std::cout << "Enabling multithread calculation." << std::endl;
-	  break;
+	} else if (*iter == "--time-budget" && iter + 1 < args.end()) {
+	  time_budget = std::stod(*(++iter));
+	} else if (*iter == "--move-budget" && iter + 1 < args.end()) {
+	  sch.moveBudget = std::stoll(*(++iter));
+	} else if (*iter == "--detail" && iter + 1 < args.end()) {
+	  window = std::stoi(*(++iter));
+	  sch.frzTemp = DETAIL_FRZ_TEMP;
+	} else if (*iter == "--congestion" && iter + 1 < args.end()) {
+	  sch.congestionWeight = std::stod(*(++iter));
+	  congestion_cost = true;
+	} else if (*iter == "--timing") {
+	  timing_cost = true;
+	} else if (*iter == "--cost" && iter + 1 < args.end()) {
+	  std::string cost = *(++iter);
+	  if (cost == "timing") {
+	    timing_cost = true;
+	  } else if (cost == "quadratic") {
+	    quadratic_cost = true;
+	  } else if (cost == "congestion") {
+	    congestion_cost = true;
+	  } else if (cost != "hpwl") {
+	    std::cout << "Unknown cost " << cost << std::endl;
+	    printUsage();
+	    exit(1);
+	  }
+	} else if (*iter == "--starts" && iter + 1 < args.end()) {
+	  starts = std::max(1, std::stoi(*(++iter)));
+	} else if (*iter == "--move" && iter + 1 < args.end()) {
+	  std::string move = *(++iter);
+	  if (move == "local") {
+	    sch.move = MOVE_LOCAL;
+	  } else if (move != "global") {
+	    std::cout << "Unknown move " << move << std::endl;
+	    printUsage();
+	    exit(1);
+	  }
+	} else if (*iter == "--reorder" && !use_bookshelf) {
+	  reorder = true;
 	}
       }
-      int lWidth = std::ceil(std::sqrt(node::doublearea/2.0));
-      //int lHeight = std::ceil(double(node::doublearea)/(2.0*lWidth));
-      int lHeight = lWidth;
-      int dlWidth = 2*lWidth; // double to make sure it is int
-      int attempts = 0;
-      bool ret = false;
-      while (!ret) {
-	destroy(rows);
-	ret = random_placement(nodes, rows, dlWidth, lHeight);
-	++ attempts;
-	if (attempts == 100) { // after 100 tries add 0.5 to Width
-	  attempts = 0;
-	  ++ dlWidth;
+      // timing and congestion add up, the quadratic length replaces HPWL
+      if (quadratic_cost && (timing_cost || congestion_cost)) {
+	std::cout << "quadratic cost does not combine with timing or "
+		  << "congestion" << std::endl;
+	printUsage();
+	exit(1);
+      }
+      if (quadratic_cost)
+	sch.cost = COST_QUADRATIC;
+      else if (timing_cost && congestion_cost)
+	sch.cost = COST_TIMING_CONGESTION;
+      else if (timing_cost)
+	sch.cost = COST_TIMING;
+      else if (congestion_cost)
+	sch.cost = COST_CONGESTION;
+      // once, whatever the position of the flag
+      if (reorder)
+	reorderCkt(nodes, inputs, outputs, circuit, rows);
+      std::vector<node*> movable;
+      if (use_bookshelf) {
+	if (!bookshelfPlacement(design, rows)) {
+	  std::cout << "cells do not fit in the rows" << std::endl;
+	  exit(1);
 	}
+	movable = design.movable;
+	sch.hardRows = true; // the .pl has to be legal
+      } else {
+	initialPlacement(nodes, rows);
+	movable = nodes;
       }
       setCoordinate(rows);
       double currentHPWL = layoutHPWL(rows);
       std::cout << "Initial HPWL:" << currentHPWL << std::endl;
-      double k = kboltz(rows, currentHPWL);
+      sch.num_moves = movable.size();
+      if (enableMultiThread)
+	sch.threads = std::max(1u, std::thread::hardware_concurrency());
+      bool timing_driven = timing_cost;
+      // an empty timer unless timing-driven
+      timer sta(timing_driven ? nodes : std::vector<node*>());
+      if (timing_driven) {
+	sta.analyse();
+	std::cout << "Initial critical delay:" << sta.criticalDelay()
+		  << std::endl;
+	sch.timing = &sta;
+      }
+      // the map is only kept when congestion is part of the cost
+      std::unique_ptr<rudyMap> congestion;
+      if (congestion_cost) {
+	if (sch.congestionWeight <= 0)
+	  sch.congestionWeight = RUDY_WEIGHT;
+	congestion.reset(new rudyMap(rows));
+	sch.congestion = congestion.get();
+      }
+      double k = kboltz(rows, sch);
       std::cout << "Initial k:" << k << std::endl;
+      if (time_budget > 0 || sch.moveBudget > 0) {
+	schedule probe = sch;
+	if (starts > 1)
+	  probe.threads = 1; // as each chain runs
+	double rate = measurePolicyRate(rows, 50, probe);
+	if (time_budget > 0) {
+	  // keep a small margin for writing the results
+	  fsec elapsed = Time::now() - start;
+	  sch.timeBudget = std::max(0.95 * time_budget - elapsed.count(),
+				    1e-3);
+	  // the post-pass runs after annealing, leave it its share
+	  if (window)
+	    sch.timeBudget *= 1.0 - DETAIL_TIME_SHARE;
+	}
+	if (starts > 1)
+	  planChains(sch, rate, starts);
+	else
+	  planSchedule(sch, rate);
+	std::cout << "Measured " << rate << " moves/s" << std::endl
+		  << "Planned schedule: T0=" << sch.maxTemp
+		  << " cooling=" << sch.coolRate
+		  << " moves/T=" << sch.num_moves << std::endl;
+      }
       
       std::ofstream annealing_step_file(annealing_step);
       if(!annealing_step_file.is_open()) {
@@ -96,8 +215,29 @@ int main(int argc, char *argv[])
       std::cout << "Writing to " << annealing_step << std::endl;
       annealing_step_file << "Temp,accepted_moves,rejected_moves,HPWL"
 			  << std::endl;
-      annealing(rows, k, currentHPWL, nodes.size(), annealing_step_file);
+      if (starts > 1)
+	multiStart(nodes, rows, k, sch, starts, !use_bookshelf,
+		   annealing_step_file);
+      else
+	annealing(rows, k, currentHPWL, sch, annealing_step_file);
       annealing_step_file.close();
+      if (window) {
+	unsigned threads = 1;
+	if (enableMultiThread)
+	  threads = std::max(1u, std::thread::hardware_concurrency());
+	// whatever annealing left of the budget
+	double detail_budget = 0.0;
+	if (time_budget > 0) {
+	  fsec elapsed = Time::now() - start;
+	  detail_budget = std::max(0.95 * time_budget - elapsed.count(), 1e-3);
+	}
+	detailedPlacement(rows, movable, window, threads, detail_budget);
+      }
+      if (timing_driven) {
+	sta.analyse();
+	std::cout << "Final critical delay:" << sta.criticalDelay()
+		  << std::endl;
+      }
 
       std::string annealing_result("annealing_result.txt");
       std::ofstream annealing_result_file(annealing_result);
@@ -107,6 +247,125 @@ int main(int argc, char *argv[])
       }
       std::cout << "Writing to " << annealing_result << std::endl;
       annealingStatistics(annealing_result_file, rows, nodes, currentHPWL);
+      if (congestion) {
+	std::string congestion_map("congestion.csv");
+	std::ofstream congestion_map_file(congestion_map);
+	if(!congestion_map_file.is_open()) {
+	  std::cout << "failed to open " << congestion_map << std::endl;
+	  exit(1);
+	}
+	std::cout << "Writing to " << congestion_map << std::endl;
+	congestion->build();
+	congestion->write(congestion_map_file);
+	std::cout << "Congestion penalty:" << congestion->penalty()
+		  << std::endl;
+      }
+      if (use_bookshelf) {
+	std::string placement_result("annealing_result.pl");
+	std::ofstream placement_result_file(placement_result);
+	if(!placement_result_file.is_open()) {
+	  std::cout << "failed to open " << placement_result << std::endl;
+	  exit(1);
+	}
+	std::cout << "Writing to " << placement_result << std::endl;
+	writeBookshelfPl(placement_result_file, design, nodes);
+	std::cout << "Bookshelf HPWL:" << bookshelfHPWL(design) << std::endl;
+      }
+    } else if (args.at(1) == "serve") {
+      if (args.size() > 3 && args[2] == "--socket")
+	return serveSocket(args[3]);
+      return serveStream(std::cin, std::cout);
+    } else if (args.at(1) == "generate") {
+      std::string ckt_filename(args.at(2));
+      genParams param;
+      param.cells = std::stoll(args.at(3));
+      for (auto iter = args.begin() + 4; iter < args.end(); ++iter) {
+	if (iter + 1 == args.end())
+	  break;
+	if (*iter == "--rent")
+	  param.rent = std::stod(*(++iter));
+	else if (*iter == "--fanout")
+	  param.fanout = std::stod(*(++iter));
+	else if (*iter == "--depth")
+	  param.depth = std::stoi(*(++iter));
+	else if (*iter == "--seed")
+	  param.seed = std::stoull(*(++iter));
+      }
+      std::ofstream ckt_file(ckt_filename);
+      if (!ckt_file.is_open()) {
+	std::cout << "failed to open " << ckt_filename << std::endl;
+	exit(1);
+      }
+      std::cout << "Writing " << param.cells << " gates to "
+		<< ckt_filename << std::endl;
+      generateCkt(ckt_file, param);
+      ckt_file.close();
+    } else if (args.at(1) == "bench") {
+      // parse, place and time moves, last line is a csv record
+      std::string ckt_filename(args.at(2));
+      bool use_bookshelf = isBookshelf(ckt_filename);
+      struct rusage usage;
+      getrusage(RUSAGE_SELF, &usage);
+      long rss = usage.ru_maxrss;
+      auto t0 = Time::now();
+      if (use_bookshelf) {
+	parseBookshelf(ckt_filename, nodes, circuit, design);
+      } else {
+	std::ifstream ckt_file(ckt_filename);
+	if (!ckt_file.is_open()) {
+	  std::cout << "failed to open " << ckt_filename << std::endl;
+	  exit(1);
+	}
+	parseCkt(ckt_file, inputs, outputs, nodes, circuit);
+	ckt_file.close();
+      }
+      fsec parse_time = Time::now() - t0;
+      // the parsed netlist is the peak so far, so the peak grew by it
+      getrusage(RUSAGE_SELF, &usage);
+      double cell_bytes = 1024.0 * (usage.ru_maxrss - rss) / nodes.size();
+      t0 = Time::now();
+      if (use_bookshelf) {
+	if (!bookshelfPlacement(design, rows)) {
+	  std::cout << "cells do not fit in the rows" << std::endl;
+	  exit(1);
+	}
+      } else {
+	initialPlacement(nodes, rows);
+      }
+      setCoordinate(rows);
+      fsec place_time = Time::now() - t0;
+      if (!checkHPWL(rows))
+	exit(1);
+      const int moves = 50;
+      double rate = 0.0, rcm_rate = 0.0;
+      long long misses = countCacheMisses([&]() {
+	  rate = measureMoveRate(rows, moves);
+	});
+      // the same loop through the policies annealing() is built from
+      double policy_rate = measurePolicyRate(rows, moves, schedule());
+      // same placement again after renumbering the cells
+      fsec reorder_time(0);
+      long long rcm_misses = -1;
+      if (!use_bookshelf) {
+	t0 = Time::now();
+	reorderCkt(nodes, inputs, outputs, circuit, rows);
+	reorder_time = Time::now() - t0;
+	rcm_misses = countCacheMisses([&]() {
+	    rcm_rate = measureMoveRate(rows, moves);
+	  });
+      }
+      getrusage(RUSAGE_SELF, &usage);
+      std::cout << "cells,parse_s,place_s,peak_rss_kB,moves_per_s,"
+		<< "misses_per_move,reorder_s,rcm_moves_per_s,"
+		<< "rcm_misses_per_move,policy_moves_per_s,bytes_per_cell"
+		<< std::endl
+		<< nodes.size() << "," << parse_time.count() << ","
+		<< place_time.count() << "," << usage.ru_maxrss << ","
+		<< rate << "," << (misses < 0 ? -1 : misses / moves) << ","
+		<< reorder_time.count() << "," << rcm_rate << ","
+		<< (rcm_misses < 0 ? -1 : rcm_misses / moves) << ","
+		<< policy_rate << "," << cell_bytes << std::endl;
+      return 0;
     } else {
       std::cout << "Not enough parameters." << std::endl;
       printUsage();
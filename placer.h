@@ -0,0 +1,70 @@
+/* C API of libplacer, the annealing placer as a library
+ *
+ * a placer holds one netlist and its placement, nothing is read from
+ * or written to files. the random generator and the gate counters are
+ * global, so run one placement at a time per process */
+#ifndef PLACER_H
+#define PLACER_H
+
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define PLACER_OK 0
+#define PLACER_ERROR -1
+
+/* same order as GateType in libckt.hpp */
+enum placer_gate {
+  PLACER_NAND, PLACER_NOR, PLACER_AND, PLACER_OR, PLACER_XOR,
+  PLACER_XNOR, PLACER_INV, PLACER_BUF, PLACER_INP, PLACER_OUTP
+};
+
+typedef struct placer placer;
+
+/* called after every temperature step, return 0 to stop annealing */
+typedef int (*placer_progress)(double temperature, double hpwl,
+			       void *user);
+
+typedef struct placer_params {
+  double max_temp;
+  double frz_temp;
+  double cool_rate;
+  /* moves per temperature, 0 means the number of cells */
+  int moves_per_temp;
+  /* budgets fit the schedule like --move-budget and --time-budget,
+   * 0 means unlimited */
+  long long move_budget;
+  double time_budget;
+  /* window of the detailed placement post-pass, 0 turns it off */
+  int detail_window;
+  unsigned threads;
+  /* 0 seeds from std::random_device */
+  unsigned long long seed;
+} placer_params;
+
+void placer_default_params(placer_params *params);
+
+placer *placer_create(void);
+void placer_destroy(placer *p);
+
+/* cell i has type types[i] and reads the cells
+ * fanin[fanin_start[i]] .. fanin[fanin_start[i+1] - 1] */
+int placer_load(placer *p, int num_cells, const int *types,
+		const int *fanin_start, const int *fanin);
+
+/* PLACER_ERROR unless 0 < cool_rate < 1 and 0 < frz_temp < max_temp */
+int placer_run(placer *p, const placer_params *params,
+	       placer_progress progress, void *user);
+
+int placer_num_cells(const placer *p);
+double placer_hpwl(const placer *p);
+/* bottom-left corner of every cell, arrays of placer_num_cells() */
+int placer_get_coordinates(const placer *p, double *x, int *y);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,15 @@
+UCLA pl 1.0
+
+g10	0	0	: N
+g11	0	0	: N
+g16	0	0	: N
+g19	0	0	: N
+g22	0	0	: N
+g23	0	0	: N
+p1	-2	0	: N /FIXED
+p2	-2	2	: N /FIXED
+p3	-2	4	: N /FIXED
+p6	-2	6	: N /FIXED
+p7	-2	8	: N /FIXED
+p22	10	2	: N /FIXED
+p23	10	6	: N /FIXED
@@ -5,19 +5,34 @@
 #include <thread>
 #include <exception>
 #include <fstream>
+#include <chrono>
+#include <deque>
+#include <unordered_map>
+#include <functional>
+
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/syscall.h>
+#include <sys/ioctl.h>
+#include <unistd.h>
+#include <cstring>
+#endif
 
 #include "libckt.hpp"
 #include "librow.hpp"
 #include "util.hpp"
-
-#define MAX_TEMP 4e4
-#define FRZ_TEMP 0.1
-#define INIT_RATE 0.995
-#define COOL_RATE 0.95
+#include "libhpwl.hpp"
+#include "libtiming.hpp"
+#include "libcongestion.hpp"
+#include "libcost.hpp"
+#include "libreport.hpp"
 
 std::random_device rd;
-std::mt19937 gen(rd());
-std::uniform_real_distribution<> dis(0,1);
+// one generator per thread, so chains annealing in parallel do not share
+thread_local std::mt19937 gen(rd());
+thread_local std::uniform_real_distribution<> dis(0,1);
+
+bool enableVerbose = true;
 
 bool random_placement(const std::vector<node*>& nodes,
 		      std::vector<row*>& rows,
@@ -67,15 +82,19 @@ bool random_placement(const std::vector<node*>& nodes,
     }
   }
   if (attempt) {
+    if (!enableVerbose)
+      return true;
     std::cout << "Random Placement Generated" << std::endl;
-    int placed_area = 0;
+    int placed_area = 0, total_area = 0;
     for (auto i : rows)
       placed_area += i->getSum();
+    for (auto i : nodes)
+      total_area += i->getDoubleWidth();
     std::cout << "Last Attempt" << std::endl
 	      << "Width:" << dlWidth/2.0 << std::endl
 	      << "Height:" << lHeight << std::endl
 	      << "Total area:"
-	      << node::doublearea/2.0 << std::endl
+	      << total_area/2.0 << std::endl
 	      << "Placed area:"
 	      << placed_area/2.0 << std::endl;
     return true;
@@ -112,11 +131,161 @@ void destroy(std::vector<row*>& rows)
   }
 }
 
+// random placement in a square, widen it until every cell fits
+void initialPlacement(const std::vector<node*>& nodes,
+		      std::vector<row*>& rows)
+{
+  // area of these nodes, node::doublearea counts every parsed node
+  int darea = 0;
+  for (auto i : nodes)
+    darea += i->getDoubleWidth();
+  int lWidth = std::ceil(std::sqrt(darea/2.0));
+  //int lHeight = std::ceil(double(node::doublearea)/(2.0*lWidth));
+  int lHeight = lWidth;
+  int dlWidth = 2*lWidth; // double to make sure it is int
+  int attempts = 0;
+  bool ret = false;
+  while (!ret) {
+    destroy(rows);
+    ret = random_placement(nodes, rows, dlWidth, lHeight);
+    ++ attempts;
+    if (attempts == 100) { // after 100 tries add 0.5 to Width
+      attempts = 0;
+      ++ dlWidth;
+    }
+  }
+}
+
 void setCoordinate(std::vector<row*>& rows)
 {
   for (std::size_t i = 0; i < rows.size(); ++i) 
     rows[i]->setCoordinate(i+1); // set coordinate for each row
 }
+// lay the cells out in memory in reverse Cuthill-McKee order of the
+// netlist graph, one block of nodes so connected cells end up close.
+// fanout lists are sorted in the new order as well. nodes keeps its
+// order, so the reports list the cells as before
+void reorderCkt(std::vector<node*>& nodes,
+		std::vector<node*>& inputs,
+		std::vector<node*>& outputs,
+		cellMap& circuit,
+		std::vector<row*>& rows)
+{
+  std::size_t n = nodes.size();
+  std::unordered_map<node*, std::size_t> index;
+  for (std::size_t i = 0; i < n; ++i)
+    index[nodes[i]] = i;
+  std::vector<std::size_t> degree(n);
+  for (std::size_t i = 0; i < n; ++i)
+    degree[i] = nodes[i]->getFanin().size() + nodes[i]->getFanout().size();
+  // every component starts from its lowest degree cell
+  std::vector<std::size_t> seeds(n);
+  for (std::size_t i = 0; i < n; ++i)
+    seeds[i] = i;
+  std::stable_sort(seeds.begin(), seeds.end(),
+		   [&degree](std::size_t a, std::size_t b) {
+		     return degree[a] < degree[b];
+		   });
+  std::vector<bool> visited(n, false);
+  std::vector<std::size_t> order;
+  order.reserve(n);
+  std::deque<std::size_t> queue;
+  std::vector<std::size_t> next;
+  for (auto seed : seeds) {
+    if (visited[seed])
+      continue;
+    visited[seed] = true;
+    queue.push_back(seed);
+    while (!queue.empty()) {
+      std::size_t v = queue.front();
+      queue.pop_front();
+      order.push_back(v);
+      next.clear();
+      for (auto i : nodes[v]->getFanin())
+	next.push_back(index[i]);
+      for (auto i : nodes[v]->getFanout())
+	next.push_back(index[i]);
+      std::stable_sort(next.begin(), next.end(),
+		       [&degree](std::size_t a, std::size_t b) {
+			 return degree[a] < degree[b];
+		       });
+      for (auto i : next) {
+	if (!visited[i]) {
+	  visited[i] = true;
+	  queue.push_back(i);
+	}
+      }
+    }
+  }
+  std::reverse(order.begin(), order.end());
+  std::vector<node*> ordered(n);
+  for (std::size_t i = 0; i < n; ++i)
+    ordered[i] = nodes[order[i]];
+  std::vector<node*> fresh = node::copyBlock(ordered);
+  std::unordered_map<node*, node*> to;
+  std::unordered_map<node*, std::size_t> rank;
+  for (std::size_t i = 0; i < n; ++i) {
+    to[nodes[order[i]]] = fresh[i];
+    rank[fresh[i]] = i;
+  }
+  auto map = [&to](node *old) {
+    return to[old];
+  };
+  for (auto i : fresh) {
+    i->remapEdges(map);
+    i->sortFanout([&rank](node *a, node *b) {
+	return rank[a] < rank[b];
+      });
+  }
+  for (auto& i : inputs)
+    i = map(i);
+  for (auto& i : outputs)
+    i = map(i);
+  for (auto& i : circuit)
+    i.second = map(i.second);
+  for (auto i : rows) {
+    std::vector<node*> cells(i->getCells());
+    for (auto& j : cells)
+      j = map(j);
+    i->setCells(cells);
+  }
+  for (auto& i : nodes) {
+    node *old = i;
+    i = map(old);
+    delete old;
+  }
+}
+
+// hardware cache misses of this thread while running work, -1 when
+// the counter is not available
+long long countCacheMisses(const std::function<void()>& work)
+{
+#ifdef __linux__
+  perf_event_attr attr;
+  std::memset(&attr, 0, sizeof(attr));
+  attr.type = PERF_TYPE_HARDWARE;
+  attr.size = sizeof(attr);
+  attr.config = PERF_COUNT_HW_CACHE_MISSES;
+  attr.disabled = 1;
+  attr.exclude_kernel = 1;
+  attr.exclude_hv = 1;
+  int fd = syscall(__NR_perf_event_open, &attr, 0, -1, -1, 0);
+  if (fd >= 0) {
+    ioctl(fd, PERF_EVENT_IOC_RESET, 0);
+    ioctl(fd, PERF_EVENT_IOC_ENABLE, 0);
+    work();
+    ioctl(fd, PERF_EVENT_IOC_DISABLE, 0);
+    long long count = -1;
+    if (read(fd, &count, sizeof(count)) != sizeof(count))
+      count = -1;
+    close(fd);
+    return count;
+  }
+#endif
+  work();
+  return -1;
+}
+
 bool accept_move(double dCost,
 		 double k,
 		 double T)
@@ -127,139 +296,353 @@ bool accept_move(double dCost,
   return r < boltz;
 }
 
-// swap two elements and set coordinate
+// swap two elements and set coordinate, changes are recorded
+// in the journal so that the move can be rolled back
 void swap(std::vector<row*>& rows,
 	  int row_idx1, int itm_idx1,
-	  int row_idx2, int itm_idx2)
+	  int row_idx2, int itm_idx2,
+	  journal& jn)
 {
   node *a = (*rows[row_idx1])[itm_idx1];
   node *b = (*rows[row_idx2])[itm_idx2];
 
+  jn.recordSlot(row_idx1, itm_idx1, a);
+  jn.recordSlot(row_idx2, itm_idx2, b);
   rows[row_idx1]->setElement(itm_idx1, b);
   rows[row_idx2]->setElement(itm_idx2, a);
 
-  rows[row_idx1]->setCoordinate(row_idx1+1);
-  rows[row_idx2]->setCoordinate(row_idx2+1);
+  if (row_idx1 == row_idx2) {
+    rows[row_idx1]->updateCoordinate(std::min(itm_idx1, itm_idx2),
+				     std::max(itm_idx1, itm_idx2),
+				     row_idx1+1, jn);
+  } else {
+    rows[row_idx1]->updateCoordinate(itm_idx1, itm_idx1, row_idx1+1, jn);
+    rows[row_idx2]->updateCoordinate(itm_idx2, itm_idx2, row_idx2+1, jn);
+  }
+}
+
+// time a number of random moves (swap, evaluate, roll back)
+double measureMoveRate(std::vector<row*>& rows, int attempts)
+{
+  typedef std::chrono::steady_clock Time;
+  journal jn;
+  hpwlEngine engine(rows);
+  auto start = Time::now();
+  for (auto i = 0; i < attempts; ++i) {
+    std::size_t size = 0;
+    int row_idx1, row_idx2;
+    while (!size) { // in case generated an empty row
+      row_idx1 = gen() % rows.size();
+      size = rows[row_idx1]->size();
+    }
+    size = 0;
+    while (!size) { // in case generated an empty row
+      row_idx2 = gen() % rows.size();
+      size = rows[row_idx2]->size();
+    }
+    int itm_idx1 = gen() % rows[row_idx1]->size();
+    int itm_idx2 = gen() % rows[row_idx2]->size();
+    swap(rows, row_idx1, itm_idx1, row_idx2, itm_idx2, jn);
+    engine.update(jn);
+    engine.compute();
+    jn.rollback(rows);
+    engine.revert();
+  }
+  std::chrono::duration<double> elapsed = Time::now() - start;
+  if (elapsed.count() <= 0.0)
+    return std::numeric_limits<double>::max();
+  return attempts / elapsed.count();
+}
+
+// the loop of measureMoveRate() through the cost and move policies
+// annealing() uses with sch, with the defaults both rates should match
+template <class Cost, class Move>
+static double measurePolicyRate(std::vector<row*>& rows, int attempts,
+				const schedule& sch)
+{
+  typedef std::chrono::steady_clock Time;
+  journal jn;
+  Cost cost(rows, sch);
+  Move move(rows);
+  cost.start();
+  auto start = Time::now();
+  for (auto i = 0; i < attempts; ++i) {
+    int row_idx1, itm_idx1, row_idx2, itm_idx2;
+    move.pick(rows, row_idx1, itm_idx1, row_idx2, itm_idx2);
+    swap(rows, row_idx1, itm_idx1, row_idx2, itm_idx2, jn);
+    cost.evaluate(jn);
+    jn.rollback(rows);
+    cost.reject();
+  }
+  std::chrono::duration<double> elapsed = Time::now() - start;
+  if (elapsed.count() <= 0.0)
+    return std::numeric_limits<double>::max();
+  return attempts / elapsed.count();
+}
+
+template <class Cost>
+static double measurePolicyRate(std::vector<row*>& rows, int attempts,
+				const schedule& sch)
+{
+  if (sch.move == MOVE_LOCAL)
+    return measurePolicyRate<Cost, localMove>(rows, attempts, sch);
+  return measurePolicyRate<Cost, globalMove>(rows, attempts, sch);
+}
+
+// moves/s of the instantiation annealing() will run with sch, what
+// planSchedule() should be given
+double measurePolicyRate(std::vector<row*>& rows, int attempts,
+			 const schedule& sch)
+{
+  if (sch.cost == COST_TIMING && sch.timing)
+    return measurePolicyRate<weightedCost>(rows, attempts, sch);
+  if (sch.cost == COST_QUADRATIC)
+    return measurePolicyRate<quadraticCost>(rows, attempts, sch);
+  if (sch.cost == COST_CONGESTION && sch.congestion)
+    return measurePolicyRate<densityCost>(rows, attempts, sch);
+  if (sch.cost == COST_TIMING_CONGESTION && sch.timing && sch.congestion)
+    return measurePolicyRate<weightedDensityCost>(rows, attempts, sch);
+  return measurePolicyRate<hpwlCost>(rows, attempts, sch);
 }
 
-void annealing(std::vector<row*>& rows,
-	       const double k,
-	       const double initHPWL,
-	       const int num_moves,
-	       std::ofstream& outFile)
+// the engine against layoutHPWL(), which sums the nets one by one.
+// swaps look for a placement with an odd doubled HPWL, where a lost .5
+// would show, and are undone after. false on a mismatch
+bool checkHPWL(std::vector<row*>& rows)
 {
+  journal jn;
+  hpwlEngine engine(rows);
+  globalMove move(rows);
+  bool ok = true;
+  for (int i = 0; i < HPWL_CHECK_MOVES && ok; ++i) {
+    double layout = layoutHPWL(rows);
+    double sum = engine.compute();
+    if (sum != layout) {
+      std::cout << "HPWL engine " << sum << " != layout " << layout
+		<< std::endl;
+      ok = false;
+    }
+    if (layout != std::floor(layout))
+      break;
+    int row_idx1, itm_idx1, row_idx2, itm_idx2;
+    move.pick(rows, row_idx1, itm_idx1, row_idx2, itm_idx2);
+    swap(rows, row_idx1, itm_idx1, row_idx2, itm_idx2, jn);
+    engine.update(jn);
+  }
+  jn.rollback(rows);
+  return ok;
+}
+
+// fit the schedule of sch into the move and time budgets
+// steps and moves per step are scaled by the same factor, and when
+// shrinking, the hot random-walk part of the schedule is cut off
+void planSchedule(schedule& sch, double moveRate)
+{
+  double steps = std::log(sch.frzTemp/sch.maxTemp) / std::log(sch.coolRate);
+  double total = steps * sch.num_moves;
+  double budget = std::numeric_limits<double>::max();
+  if (sch.moveBudget > 0)
+    budget = std::min(budget, double(sch.moveBudget));
+  if (sch.timeBudget > 0)
+    budget = std::min(budget, sch.timeBudget * moveRate);
+  if (budget == std::numeric_limits<double>::max() || sch.num_moves <= 0)
+    return;
+  double f = std::sqrt(budget / total);
+  double new_steps = std::max(10.0, std::floor(steps * f));
+  double coolRate = sch.coolRate;
+  sch.num_moves = std::max(1, int(budget / new_steps));
+  sch.maxTemp *= std::min(1.0, f);
+  sch.coolRate = std::pow(sch.frzTemp/sch.maxTemp, 1.0/new_steps);
+  if (sch.coolRate >= 1.0) // budget too small to cool at all
+    sch.coolRate = coolRate;
+}
+
+// one instantiation per cost and move policy, see libcost.hpp
+template <class Cost, class Move>
+static double annealing(std::vector<row*>& rows,
+			const double k,
+			const double initHPWL,
+			const schedule& sch,
+			std::ostream& outFile)
+{
+  typedef std::chrono::steady_clock Time;
+  // the budget also covers setting up the cost and the snapshot
+  auto deadline = Time::now()
+    + std::chrono::duration_cast<Time::duration>(
+	std::chrono::duration<double>(sch.timeBudget));
+  Cost cost(rows, sch);
+  Move move(rows);
   double currentHPWL = initHPWL;
-  double T = MAX_TEMP;
-  while (T > FRZ_TEMP) {
+  double bestHPWL = initHPWL;
+  double currentCost = cost.start();
+  double bestCost = currentCost;
+  double T = sch.maxTemp;
+  journal jn;
+  snapshot best;
+  best.take(rows);
+  long long total_moves = 0;
+  bool out_of_budget = false;
+  while (T > sch.frzTemp && !out_of_budget) {
     int accepted_moves = 0, rejected_moves = 0;
-    for (auto i = 0; i < num_moves; ++i) {
-      // generate a pair of node, swap, if not accepted swap back
-      std::size_t size = 0;
-      double newHPWL, dCost;
-      int row_idx1, row_idx2;
-      while (!size) { // in case generated an empty row
-	row_idx1 = gen() % rows.size();
-	size = rows[row_idx1]->size();
+    for (auto i = 0; i < sch.num_moves; ++i) {
+      if (sch.moveBudget > 0 && total_moves == sch.moveBudget) {
+	out_of_budget = true;
+	break;
       }
-      size = 0;
-      while (!size) { // in case generated an empty row
-	row_idx2 = gen() % rows.size();
-	size = rows[row_idx2]->size();
+      // checking the clock is not free, do it every 64 moves
+      if (sch.timeBudget > 0 && !(total_moves & 63)
+	  && Time::now() > deadline) {
+	out_of_budget = true;
+	break;
+      }
+      ++total_moves;
+      // generate a pair of node, swap, if not accepted swap back
+      int row_idx1, itm_idx1, row_idx2, itm_idx2;
+      move.pick(rows, row_idx1, itm_idx1, row_idx2, itm_idx2);
+      swap(rows, row_idx1, itm_idx1, row_idx2, itm_idx2, jn);
+      if (sch.hardRows
+	  && (rows[row_idx1]->getSum() > rows[row_idx1]->getLimit()
+	      || rows[row_idx2]->getSum() > rows[row_idx2]->getLimit())) {
+	jn.rollback(rows);
+	++rejected_moves;
+	continue;
       }
-      int itm_idx1 = gen() % rows[row_idx1]->size();
-      int itm_idx2 = gen() % rows[row_idx2]->size();
-      swap(rows, row_idx1, itm_idx1, row_idx2, itm_idx2);
-      newHPWL = layoutHPWL(rows);
-      dCost = newHPWL - currentHPWL;
+      double newCost = cost.evaluate(jn);
+      double dCost = newCost - currentCost;
       if (accept_move(dCost, k, T)) {
-	currentHPWL = newHPWL;
+	currentCost = newCost;
 	++accepted_moves;
-      } else { // if not accepted, change the items back
-	swap(rows, row_idx1, itm_idx1, row_idx2, itm_idx2);
+	cost.accept(jn);
+	best.record(jn);
+	jn.clear();
+	if (Cost::stable && currentCost < bestCost) {
+	  bestCost = currentCost;
+	  best.commit(rows);
+	}
+      } else { // if not accepted, undo the recorded changes
+	jn.rollback(rows);
+	cost.reject();
 	++rejected_moves;
       }
     }
-    std::cout << "Current Temperature:" << T << std::endl;
+    currentHPWL = cost.hpwl();
+    if (enableVerbose)
+      std::cout << "Current Temperature:" << T << std::endl;
     outFile << T << "," << accepted_moves << ","
 	    << rejected_moves << ","
 	    << currentHPWL << std::endl;
-    T *= COOL_RATE; // cool down
+    if (sch.progress && !sch.progress(T, currentHPWL))
+      break;
+    currentCost = cost.step(currentCost);
+    if (accepted_moves + rejected_moves)
+      move.step(double(accepted_moves) / (accepted_moves + rejected_moves));
+    T *= sch.coolRate; // cool down
+  }
+  if (out_of_budget && enableVerbose)
+    std::cout << "Budget exhausted after " << total_moves << " moves"
+	      << std::endl;
+  // report the best placement instead of the frozen one
+  if (Cost::stable && bestCost < currentCost) {
+    best.restore(rows);
+    setCoordinate(rows);
+    bestHPWL = cost.hpwl();
+    if (enableVerbose)
+      std::cout << "Restored best HPWL:" << bestHPWL << std::endl;
+    return bestHPWL;
   }
+  return cost.hpwl();
 }
 
-double layoutHPWL(std::vector<row*>& rows)
+template <class Cost>
+static double annealing(std::vector<row*>& rows, const double k,
+			const double initHPWL, const schedule& sch,
+			std::ostream& outFile)
 {
-  double sum = 0.0;
-  for (auto i: rows)
-    sum += i->calHPWL();
-  return sum;
+  if (sch.move == MOVE_LOCAL)
+    return annealing<Cost, localMove>(rows, k, initHPWL, sch, outFile);
+  return annealing<Cost, globalMove>(rows, k, initHPWL, sch, outFile);
 }
 
-double layoutHPWL_multithread(std::vector<row*>& rows)
+// pick the instantiation once, returns the HPWL of the final placement
+double annealing(std::vector<row*>& rows,
+		 const double k,
+		 const double initHPWL,
+		 const schedule& sch,
+		 std::ostream& outFile)
+{
+  if (sch.cost == COST_TIMING && sch.timing)
+    return annealing<weightedCost>(rows, k, initHPWL, sch, outFile);
+  if (sch.cost == COST_QUADRATIC)
+    return annealing<quadraticCost>(rows, k, initHPWL, sch, outFile);
+  if (sch.cost == COST_CONGESTION && sch.congestion)
+    return annealing<densityCost>(rows, k, initHPWL, sch, outFile);
+  if (sch.cost == COST_TIMING_CONGESTION && sch.timing && sch.congestion)
+    return annealing<weightedDensityCost>(rows, k, initHPWL, sch, outFile);
+  return annealing<hpwlCost>(rows, k, initHPWL, sch, outFile);
+}
+
+double layoutHPWL(std::vector<row*>& rows)
 {
-  // use threads to compute layout HPWL
-  std::size_t height = rows.size();
   double sum = 0.0;
-  const unsigned int n = std::thread::hardware_concurrency();
-  double *results = new double[n];
-  std::size_t *split = new std::size_t[n+1];
-  std::thread *threads = new std::thread[height];
-  for (unsigned i = 0; i < n; ++i)
-    split[i] = i * height / n;
-  split[n] = height;
-  // each thread calculate the hpwl for one row
-  for (unsigned i = 1; i < n; ++i)
-    threads[i] = std::thread([&rows, results, split, i]() {
-			       double inner_sum = 0.0;
-			       for (auto j = split[i]; j < split[i+1]; ++j)
-				 inner_sum += rows[j]->calHPWL();
-			       results[i] = inner_sum;
-			     });
-  for (auto j = split[0]; j < split[1]; ++j)
-    sum += rows[j]->calHPWL();
-  for (unsigned i = 1; i < n; ++i) {
-    threads[i].join();
-    sum += results[i];
-  }
+  for (auto i: rows)
+    sum += i->calHPWL();
   return sum;
 }
 
-// choose k based on 50 increasing cost
-double kboltz(std::vector<row*>& rows,
-	      double initHPWL)
+// choose k based on 50 increasing cost. a netlist where few moves
+// raise the cost gets the k of a one site increase
+template <class Cost, class Move>
+static double kboltz(std::vector<row*>& rows, const schedule& sch)
 {
-  double currentHPWL = 0;
   double avgdCost = 0;
   int i = 0;
   const int attempts = 50;
-  while (i < 50) {
+  journal jn;
+  Cost cost(rows, sch);
+  Move move(rows);
+  double initCost = cost.start();
+  for (int tries = 0; i < attempts && tries < KBOLTZ_TRIES; ++tries) {
     // generate a pair of node, swap then swap back
-    std::size_t size = 0;
-    int row_idx1, row_idx2;
-    while (!size) { // in case generated an empty row, likely to happen on c17
-      row_idx1 = gen() % rows.size();
-      size = rows[row_idx1]->size();
-    }
-    size = 0;
-    while (!size) { // in case generated an empty row
-      row_idx2 = gen() % rows.size();
-      size = rows[row_idx2]->size();
-    }
-    int itm_idx1 = gen() % rows[row_idx1]->size();
-    int itm_idx2 = gen() % rows[row_idx2]->size();
-    swap(rows, row_idx1, itm_idx1, row_idx2, itm_idx2);
-    currentHPWL = layoutHPWL(rows);
-    double dCost = currentHPWL - initHPWL;
+    int row_idx1, itm_idx1, row_idx2, itm_idx2;
+    move.pick(rows, row_idx1, itm_idx1, row_idx2, itm_idx2);
+    swap(rows, row_idx1, itm_idx1, row_idx2, itm_idx2, jn);
+    double dCost = cost.evaluate(jn) - initCost;
     if (dCost > 0) {
       avgdCost += dCost;
       ++i;
     }
-    swap(rows, row_idx1, itm_idx1, row_idx2, itm_idx2);
+    jn.rollback(rows);
+    cost.reject();
   }
-  avgdCost /= attempts;
+  if (i < KBOLTZ_MIN_UPHILL)
+    avgdCost = 1.0;
+  else
+    avgdCost /= i;
   return 0 - avgdCost / (std::log(INIT_RATE)*MAX_TEMP);
 }
 
+template <class Cost>
+static double kboltz(std::vector<row*>& rows, const schedule& sch)
+{
+  if (sch.move == MOVE_LOCAL)
+    return kboltz<Cost, localMove>(rows, sch);
+  return kboltz<Cost, globalMove>(rows, sch);
+}
+
+// k for the cost and move annealing() will use with sch
+double kboltz(std::vector<row*>& rows, const schedule& sch)
+{
+  if (sch.cost == COST_TIMING && sch.timing)
+    return kboltz<weightedCost>(rows, sch);
+  if (sch.cost == COST_QUADRATIC)
+    return kboltz<quadraticCost>(rows, sch);
+  if (sch.cost == COST_CONGESTION && sch.congestion)
+    return kboltz<densityCost>(rows, sch);
+  if (sch.cost == COST_TIMING_CONGESTION && sch.timing && sch.congestion)
+    return kboltz<weightedDensityCost>(rows, sch);
+  return kboltz<hpwlCost>(rows, sch);
+}
+
 void annealingStatistics(std::ofstream& outFile,
 			 std::vector<row*>& rows,
 			 std::vector<node*>& nodes,
@@ -276,9 +659,17 @@ void annealingStatistics(std::ofstream& outFile,
 	  << "Final Height:\t" << Height << std::endl
 	  << "Total Area:\t" << Height * dWidth / 2.0
 	  << std::endl << std::endl
-	  << "Coordinates of bottem-left corner of each cell" << std::endl;
-  for (auto i:nodes)
-    outFile << i->getName() << "\t\t"
-	    << "X:" << i->getDoubleX() / 2.0 << "\t"
-	    << "Y:" << i->getY() << std::endl;
+	  << "Coordinates of bottem-left corner of each cell\n";
+  writeSection(outFile, nodes.size(),
+	       [&nodes](std::string& out, std::size_t begin, std::size_t end) {
+		 for (std::size_t i = begin; i < end; ++i) {
+		   nodes[i]->appendName(out);
+		   out += "\t\tX:";
+		   appendHalf(out, nodes[i]->getDoubleX());
+		   out += "\tY:";
+		   appendInt(out, nodes[i]->getY());
+		   out += '\n';
+		 }
+	       });
+  outFile.flush();
 }
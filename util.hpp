@@ -1,6 +1,25 @@
 #ifndef UTIL_H
 #define UTIL_H
 
+#include <functional>
+#include <iostream>
+
+#define MAX_TEMP 4e4
+#define FRZ_TEMP 0.1
+#define INIT_RATE 0.995
+#define COOL_RATE 0.95
+// below this the annealer only accepts improvements, the detailed
+// placement post-pass finishes the job faster
+#define DETAIL_FRZ_TEMP 10.0
+// share of a time budget kept for the detailed placement post-pass
+#define DETAIL_TIME_SHARE 0.2
+// kboltz() gives up after this many moves, and needs this many of
+// them to raise the cost
+#define KBOLTZ_TRIES 5000
+#define KBOLTZ_MIN_UPHILL 10
+// swaps checkHPWL() tries to reach an odd doubled HPWL
+#define HPWL_CHECK_MOVES 100
+
 // at location n, exchange with last element and pop it
 template <typename T>
 T remove_at(std::vector<T>& v,typename std::vector<T>::size_type n)
@@ -16,22 +35,82 @@ T remove_at(std::vector<T>& v,typename std::vector<T>::size_type n)
 }
 
 
+class timer;
+class rudyMap;
+
+// objective and move of annealing(), chosen once per run, each pair is
+// a separate instantiation
+enum CostModel {COST_HPWL, COST_TIMING, COST_QUADRATIC, COST_CONGESTION,
+		COST_TIMING_CONGESTION};
+enum MoveModel {MOVE_GLOBAL, MOVE_LOCAL};
+
+// cooling schedule used by annealing()
+struct schedule {
+  double maxTemp = MAX_TEMP;
+  double frzTemp = FRZ_TEMP;
+  double coolRate = COOL_RATE;
+  // moves per temperature
+  int num_moves = 0;
+  // stop when either budget runs out, 0 means unlimited
+  long long moveBudget = 0;
+  double timeBudget = 0.0; // seconds
+  // threads of the full HPWL evaluation
+  unsigned threads = 1;
+  // the row limits are hard, a move that overfills a row is undone
+  // before it is evaluated. rows with gaps need it to stay legal
+  bool hardRows = false;
+  // called after every temperature step, returning false stops
+  std::function<bool(double T, double HPWL)> progress;
+  CostModel cost = COST_HPWL;
+  MoveModel move = MOVE_GLOBAL;
+  // timing of COST_TIMING(_CONGESTION), nets are weighted by criticality
+  timer *timing = nullptr;
+  // map of COST_(TIMING_)CONGESTION, the penalty times congestionWeight
+  // is added to the HPWL
+  rudyMap *congestion = nullptr;
+  double congestionWeight = 0.0;
+};
+
+// progress messages on stdout, the library turns them off
+extern bool enableVerbose;
+
 bool random_placement(const std::vector<node*>& nodes,
 		      std::vector<row*>& rows,
 		      int dlWidth, int lHeight);
 
 void destroy(std::vector<row*>& rows);
+void initialPlacement(const std::vector<node*>& nodes,
+		      std::vector<row*>& rows);
 
 double layoutHPWL(std::vector<row*>& rows);
-double kboltz(std::vector<row*>& rows, double initHPWL);
+double kboltz(std::vector<row*>& rows, const schedule& sch);
 
 void setCoordinate(std::vector<row*>& rows);
 
-void annealing(std::vector<row*>& rows,
-	       const double k,
-	       const double initHPWL,
-	       const int num_moves,
-	       std::ofstream& outFile);
+void reorderCkt(std::vector<node*>& nodes,
+		std::vector<node*>& inputs,
+		std::vector<node*>& outputs,
+		cellMap& circuit,
+		std::vector<row*>& rows);
+long long countCacheMisses(const std::function<void()>& work);
+
+bool accept_move(double dCost, double k, double T);
+void swap(std::vector<row*>& rows,
+	  int row_idx1, int itm_idx1,
+	  int row_idx2, int itm_idx2,
+	  journal& jn);
+
+double measureMoveRate(std::vector<row*>& rows, int attempts);
+double measurePolicyRate(std::vector<row*>& rows, int attempts,
+			 const schedule& sch);
+bool checkHPWL(std::vector<row*>& rows);
+void planSchedule(schedule& sch, double moveRate);
+
+double annealing(std::vector<row*>& rows,
+		 const double k,
+		 const double initHPWL,
+		 const schedule& sch,
+		 std::ostream& outFile);
 
 void annealingStatistics(std::ofstream& outFile,
 			 std::vector<row*>& rows,